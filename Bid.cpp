@@ -3,4 +3,5 @@
 Bid::Bid()
 {
 	amount = 0.0;
+	closeDate = NO_DATE;
 }
\ No newline at end of file
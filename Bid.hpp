@@ -1,6 +1,12 @@
 #pragma once
+#include <cstdint>
 #include <string>
 
+/**
+ * Close date used for bids whose date is missing or unreadable.
+ */
+const int32_t NO_DATE = INT32_MIN;
+
 /**
  * Define a structure to hold bid information.
  */
@@ -8,7 +14,9 @@ struct Bid {
 	std::string bidId; // unique identifier
 	std::string title;
 	std::string fund;
+	std::string department;
 	double amount;
+	int32_t closeDate; // days since 1/1/1970
 	Bid();
 };
 
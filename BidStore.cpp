@@ -0,0 +1,349 @@
+#include "BidStore.hpp"
+#include <algorithm>
+
+/**
+ * Copy a string to the end of the shared arena.
+ * @param value: The characters to copy.
+ * @param length: The number of characters.
+ * @return The offset of the first character within the arena.
+ */
+uint32_t BidStore::appendString(const char* value, size_t length) {
+	uint32_t offset = (uint32_t)arena.size();
+
+	arena.append(value, length);
+
+	return offset;
+}
+
+/**
+ * Point a string field at a new value, overwriting the old characters when
+ * the new value fits in their place.
+ * @param offset: The field's offset into the arena.
+ * @param length: The field's length.
+ * @param value: The new value.
+ */
+void BidStore::setString(uint32_t* offset, uint32_t* length, const std::string& value) {
+	if (value.size() <= *length) {
+		std::copy(value.begin(), value.end(), arena.begin() + *offset);
+	}
+	else {
+		*offset = appendString(value.data(), value.size());
+	}
+
+	*length = (uint32_t)value.size();
+}
+
+/**
+ * Write a bid's fields to a slot, reusing a released slot when one is available.
+ * @return The handle of the stored bid.
+ */
+uint32_t BidStore::store(uint32_t key, double amount, int32_t closeDate, const char* title, size_t titleLength, uint32_t fund, uint32_t department) {
+	uint32_t handle;
+
+	if (!freeSlots.empty()) {
+		handle = freeSlots.back();
+		freeSlots.pop_back();
+
+		keys[handle] = key;
+		amounts[handle] = amount;
+		closeDates[handle] = closeDate;
+		titleOffsets[handle] = appendString(title, titleLength);
+		titleLengths[handle] = (uint32_t)titleLength;
+		fundCodes[handle] = fund;
+		departmentCodes[handle] = department;
+	}
+	else {
+		handle = (uint32_t)keys.size();
+
+		keys.push_back(key);
+		amounts.push_back(amount);
+		closeDates.push_back(closeDate);
+		titleOffsets.push_back(appendString(title, titleLength));
+		titleLengths.push_back((uint32_t)titleLength);
+		fundCodes.push_back(fund);
+		departmentCodes.push_back(department);
+	}
+
+	return handle;
+}
+
+/**
+ * Add a bid to the store.
+ * @param bid: The bid to copy into the store.
+ * @return The handle of the stored bid.
+ */
+uint32_t BidStore::Add(const Bid& bid) {
+	uint32_t key = 0;
+	ParseKey(bid.bidId, &key);
+
+	return store(key, bid.amount, bid.closeDate, bid.title.data(), bid.title.size(), labels.Intern(bid.fund), labels.Intern(bid.department));
+}
+
+/**
+ * Copy every slot of another store, free ones included, after this store's
+ * slots. Whole columns are copied at once rather than bid by bid.
+ * @param source: The store to copy from.
+ * @return The handle the source's first slot has here. A bid with handle h in
+ *     the source has this plus h here.
+ */
+uint32_t BidStore::Append(const BidStore& source) {
+	uint32_t base = (uint32_t)keys.size();
+	uint32_t arenaBase = (uint32_t)arena.size();
+	size_t slots = source.keys.size();
+
+	// Codes are local to each store's dictionary, so each distinct one is translated once, through its string.
+	std::vector<uint32_t> codes(source.labels.Size());
+
+	for (size_t i = 0; i < codes.size(); i++) {
+		codes[i] = labels.Intern(source.labels.Value((uint32_t)i));
+	}
+
+	keys.insert(keys.end(), source.keys.begin(), source.keys.end());
+	amounts.insert(amounts.end(), source.amounts.begin(), source.amounts.end());
+	closeDates.insert(closeDates.end(), source.closeDates.begin(), source.closeDates.end());
+	titleLengths.insert(titleLengths.end(), source.titleLengths.begin(), source.titleLengths.end());
+	arena.append(source.arena);
+
+	for (size_t i = 0; i < slots; i++) {
+		titleOffsets.push_back(source.titleOffsets[i] + arenaBase);
+		fundCodes.push_back(codes[source.fundCodes[i]]);
+		departmentCodes.push_back(codes[source.departmentCodes[i]]);
+	}
+
+	for (size_t i = 0; i < source.freeSlots.size(); i++) {
+		freeSlots.push_back(base + source.freeSlots[i]);
+	}
+
+	return base;
+}
+
+/**
+ * Replace the fields of a stored bid.
+ * @param handle: The handle of the bid to replace.
+ * @param bid: The new values.
+ */
+void BidStore::Set(uint32_t handle, const Bid& bid) {
+	uint32_t key = 0;
+	ParseKey(bid.bidId, &key);
+
+	keys[handle] = key;
+	amounts[handle] = bid.amount;
+	closeDates[handle] = bid.closeDate;
+	setString(&titleOffsets[handle], &titleLengths[handle], bid.title);
+	fundCodes[handle] = labels.Intern(bid.fund);
+	departmentCodes[handle] = labels.Intern(bid.department);
+}
+
+/**
+ * Release a bid so its slot can be reused. The characters it used in the
+ * arena are not reclaimed; the arena is freed with the store.
+ * @param handle: The handle of the bid to release.
+ */
+void BidStore::Release(uint32_t handle) {
+	// Zero the amount so column scans can sum every slot without checking liveness.
+	amounts[handle] = 0.0;
+	titleLengths[handle] = 0;
+
+	freeSlots.push_back(handle);
+}
+
+/**
+ * Count the fund and department values of a bid that the dictionary lacks.
+ * @param bid: The bid about to be stored.
+ * @return The number of values that would be interned.
+ */
+size_t BidStore::newLabels(const Bid& bid) const {
+	uint32_t code;
+	size_t count = 0;
+
+	if (!labels.Find(bid.fund, &code)) {
+		++count;
+	}
+	if (bid.department != bid.fund && !labels.Find(bid.department, &code)) {
+		++count;
+	}
+
+	return count;
+}
+
+/**
+ * Check whether adding a bid would move the columns, the arena or the dictionary.
+ * @param bid: The bid about to be added.
+ * @return True if Grow must be called first.
+ */
+bool BidStore::NeedsGrowth(const Bid& bid) const {
+	bool columnsFull = freeSlots.empty() && keys.size() == keys.capacity();
+	bool arenaFull = arena.size() + bid.title.size() > arena.capacity();
+
+	return columnsFull || arenaFull || labels.NeedsGrowth(newLabels(bid));
+}
+
+/**
+ * Make room for at least one more bid, doubling the columns and the arena
+ * so growth happens rarely.
+ * @param bid: The bid about to be added.
+ */
+void BidStore::Grow(const Bid& bid) {
+	if (freeSlots.empty() && keys.size() == keys.capacity()) {
+		size_t slots = std::max<size_t>(64, keys.capacity() * 2);
+
+		keys.reserve(slots);
+		amounts.reserve(slots);
+		closeDates.reserve(slots);
+		titleOffsets.reserve(slots);
+		titleLengths.reserve(slots);
+		fundCodes.reserve(slots);
+		departmentCodes.reserve(slots);
+	}
+
+	size_t needed = arena.size() + bid.title.size();
+
+	if (needed > arena.capacity()) {
+		arena.reserve(std::max(needed, arena.capacity() * 2));
+	}
+
+	labels.Reserve(newLabels(bid));
+}
+
+/**
+ * Make room to append another store in one step.
+ * @param source: The store about to be appended.
+ */
+void BidStore::Reserve(const BidStore& source) {
+	// Grow at least twofold, so merging many stores one after another doesn't move the columns every time.
+	size_t slots = keys.size() + source.keys.size();
+
+	if (slots > keys.capacity()) {
+		slots = std::max(slots, keys.capacity() * 2);
+	}
+
+	keys.reserve(slots);
+	amounts.reserve(slots);
+	closeDates.reserve(slots);
+	titleOffsets.reserve(slots);
+	titleLengths.reserve(slots);
+	fundCodes.reserve(slots);
+	departmentCodes.reserve(slots);
+	if (arena.size() + source.arena.size() > arena.capacity()) {
+		arena.reserve(std::max(arena.size() + source.arena.size(), arena.capacity() * 2));
+	}
+	labels.Reserve(source.labels.Size());
+	freeSlots.reserve(freeSlots.size() + source.freeSlots.size());
+}
+
+/**
+ * Assemble a bid from its columns.
+ * @param handle: The handle of the bid.
+ * @return A copy of the bid.
+ */
+Bid BidStore::Get(uint32_t handle) const {
+	Bid bid;
+
+	bid.bidId = std::to_string(keys[handle]);
+	bid.title = Title(handle);
+	bid.fund = Fund(handle);
+	bid.department = Department(handle);
+	bid.amount = amounts[handle];
+	bid.closeDate = closeDates[handle];
+
+	return bid;
+}
+
+/**
+ * Get the title of a bid.
+ * @param handle: The handle of the bid.
+ * @return A copy of the title.
+ */
+std::string BidStore::Title(uint32_t handle) const {
+	return std::string(arena.data() + titleOffsets[handle], titleLengths[handle]);
+}
+
+/**
+ * Get the fund of a bid.
+ * @param handle: The handle of the bid.
+ * @return A copy of the fund.
+ */
+std::string BidStore::Fund(uint32_t handle) const {
+	return labels.Value(fundCodes[handle]);
+}
+
+/**
+ * Get the department of a bid.
+ * @param handle: The handle of the bid.
+ * @return A copy of the department.
+ */
+std::string BidStore::Department(uint32_t handle) const {
+	return labels.Value(departmentCodes[handle]);
+}
+
+/**
+ * Sum the amount of every bid in the store.
+ * @return The total amount.
+ */
+double BidStore::SumAmounts() const {
+	// A straight loop over one contiguous column, so the compiler can vectorize it.
+	const double* column = amounts.data();
+	size_t length = amounts.size();
+	double total = 0.0;
+
+	for (size_t i = 0; i < length; i++) {
+		total += column[i];
+	}
+
+	return total;
+}
+
+/**
+ * Get the number of live bids in the store.
+ * @return The number of bids.
+ */
+size_t BidStore::Count() const {
+	return keys.size() - freeSlots.size();
+}
+
+/**
+ * Estimate the heap memory held by the store.
+ * @return The number of bytes reserved by the columns and the arena.
+ */
+size_t BidStore::MemoryUsage() const {
+	return keys.capacity() * sizeof(uint32_t)
+		+ amounts.capacity() * sizeof(double)
+		+ closeDates.capacity() * sizeof(int32_t)
+		+ titleOffsets.capacity() * sizeof(uint32_t)
+		+ titleLengths.capacity() * sizeof(uint32_t)
+		+ fundCodes.capacity() * sizeof(uint32_t)
+		+ departmentCodes.capacity() * sizeof(uint32_t)
+		+ arena.capacity()
+		+ labels.MemoryUsage()
+		+ freeSlots.capacity() * sizeof(uint32_t);
+}
+
+/**
+ * Convert a bid id to the integer key used by the store.
+ * @param bidId: The bid id as read from the CSV file.
+ * @param key: Receives the key.
+ * @return True if the id is a decimal number that fits in 32 bits, written
+ *     without a sign or leading zeros, so the key converts back to the same id.
+ */
+bool BidStore::ParseKey(const std::string& bidId, uint32_t* key) {
+	uint64_t value = 0;
+
+	if (bidId.empty() || bidId.size() > 10 || (bidId[0] == '0' && bidId.size() > 1)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < bidId.size(); i++) {
+		if (bidId[i] < '0' || bidId[i] > '9') {
+			return false;
+		}
+
+		value = value * 10 + (uint64_t)(bidId[i] - '0');
+	}
+
+	if (value > 0xFFFFFFFFull) {
+		return false;
+	}
+
+	*key = (uint32_t)value;
+	return true;
+}
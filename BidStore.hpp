@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Bid.hpp"
+#include "StringDictionary.hpp"
+
+/**
+ * Define a column store holding every bid field in its own contiguous array.
+ * Titles share a single character arena. Funds and departments take only a
+ * few distinct values, so they are stored as codes into a shared dictionary.
+ * Bids are addressed by a 32-bit handle which stays valid until the bid is
+ * released. Adding a bid only moves the columns when NeedsGrowth says so,
+ * which lets readers on other threads keep reading existing bids meanwhile.
+ */
+class BidStore {
+
+private:
+	std::vector<uint32_t> keys;
+	std::vector<double> amounts;
+	std::vector<int32_t> closeDates;
+	std::vector<uint32_t> titleOffsets;
+	std::vector<uint32_t> titleLengths;
+	std::vector<uint32_t> fundCodes;
+	std::vector<uint32_t> departmentCodes;
+	std::string arena;
+	StringDictionary labels;
+	std::vector<uint32_t> freeSlots;
+
+	uint32_t appendString(const char* value, size_t length);
+	uint32_t store(uint32_t key, double amount, int32_t closeDate, const char* title, size_t titleLength, uint32_t fund, uint32_t department);
+	size_t newLabels(const Bid& bid) const;
+	void setString(uint32_t* offset, uint32_t* length, const std::string& value);
+
+public:
+	uint32_t Add(const Bid& bid);
+	uint32_t Append(const BidStore& source);
+	void Set(uint32_t handle, const Bid& bid);
+	void Release(uint32_t handle);
+	bool NeedsGrowth(const Bid& bid) const;
+	void Grow(const Bid& bid);
+	void Reserve(const BidStore& source);
+	Bid Get(uint32_t handle) const;
+	uint32_t Key(uint32_t handle) const { return keys[handle]; }
+	const uint32_t* KeyAddress(uint32_t handle) const { return keys.data() + handle; }
+	double Amount(uint32_t handle) const { return amounts[handle]; }
+	int32_t CloseDate(uint32_t handle) const { return closeDates[handle]; }
+	std::string Title(uint32_t handle) const;
+	const char* TitleData(uint32_t handle) const { return arena.data() + titleOffsets[handle]; }
+	uint32_t TitleLength(uint32_t handle) const { return titleLengths[handle]; }
+	std::string Fund(uint32_t handle) const;
+	std::string Department(uint32_t handle) const;
+	uint32_t FundCode(uint32_t handle) const { return fundCodes[handle]; }
+	uint32_t DepartmentCode(uint32_t handle) const { return departmentCodes[handle]; }
+	const StringDictionary& Labels() const { return labels; }
+	double SumAmounts() const;
+	size_t Count() const;
+	size_t MemoryUsage() const;
+
+	static bool ParseKey(const std::string& bidId, uint32_t* key);
+};
@@ -1,53 +1,47 @@
 #include "BinarySearchTree.hpp"
+#include "TreeSnapshot.hpp"
 #include "StaticMethods.hpp"
+#include "Prefetch.hpp"
 #include <sstream>
 #include <fstream>
 #include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <limits>
+#include <queue>
 
 /**
  * Default constructor
  */
 BinarySearchTree::BinarySearchTree() {
 	// initialize housekeeping variables
-	root = 0;
-}
-
-void BinarySearchTree::deleteAll(Node* node) {
-	if (node == 0) {
-		return;
-	}
-
-	// Recurse down left and right subtrees.
-	deleteAll(node->left);
-	deleteAll(node->right);
-
-	// Free memory allocated for node and the bid it points to.
-	delete node->bid;
-	delete node;
+	root = NIL_INDEX;
+	frozen = false;
+	secondaryIndexed = false;
+	titleIndexed = false;
+	hashIndexed = false;
+	epoch = 0;
 }
 
 /**
  * Destructor
  */
 BinarySearchTree::~BinarySearchTree() {
-	// recurse from root deleting every node
-	deleteAll(this->root);
+	// The node pool and bid store release their memory on their own.
 }
 
 /**
- * Traverse the tree in order
+ * Traverse the tree in order. Reads a snapshot, so the tree can keep changing meanwhile.
  */
 void BinarySearchTree::InOrder() {
-	Node* node = this->root;
+	std::shared_ptr<TreeSnapshot> version = Snapshot();
+	std::vector<Bid> batch;
 
-	if (node == 0) {
-		return;
+	while (version->NextBatch(&batch)) {
+		for (size_t i = 0; i < batch.size(); i++) {
+			BST::displayBid(batch[i]);
+		}
 	}
-
-	inOrder(node->left);
-	BST::displayBid(*node->bid);
-	inOrder(node->right);
 }
 
 /**
@@ -78,86 +72,171 @@ std::string BinarySearchTree::fixQuotes(std::string source)
 }
 
 /**
-* Recursively prints out each of the bids to a JSON array in order of ID (public method).
+* Prints out each of the bids to a JSON array in order of ID. Reads a snapshot,
+* so the tree can keep changing while the file is written.
 */
 void BinarySearchTree::InOrderJSON()
 {
-	Node* node = this->root;
+	std::shared_ptr<TreeSnapshot> version = Snapshot();
+	std::vector<Bid> batch;
 
-	if (node == 0) {
+	if (!version->NextBatch(&batch)) {
 		return;
 	}
 
-	std::stringstream buffer; // A stream to hold the contents of the JSON file.
-	buffer << "{\"bids\":[" << std::endl;
+	std::ofstream file;
+	file.open("bids.json");
+	file << "{\"bids\":[" << std::endl;
 
-	// Recursively run the method down the left half of the tree.
-	inOrderJSON(node->left, &buffer);
+	bool first = true;
 
-	std::string altTitle = fixQuotes(node->bid->title);
+	do {
+		for (size_t i = 0; i < batch.size(); i++) {
+			// Separate the objects with commas. Trailing commas are not allowed in JSON.
+			if (!first) {
+				file << "," << std::endl;
+			}
+			first = false;
 
-	// Print the root node bid as a JSON object.
-	buffer << "    {\"id\":\"" << node->bid->bidId << "\",";
-	buffer << "\"title\":\"" << altTitle << "\",";
-	buffer << "\"amount\":\"" << node->bid->amount << "\",";
-	buffer << "\"fund\":\"" << node->bid->fund << "\"}," << std::endl;
-	
-	// Recursively run the method down the right half of the tree.
-	inOrderJSON(node->right, &buffer);
+			std::string altTitle = fixQuotes(batch[i].title);
 
-	std::stringstream fixedBuffer;
-	fixedBuffer << buffer.str().substr(0, strlen(buffer.str().c_str()) - 2); // Get a sub string from the buffer to remove the trailing comma. Trailing commas are not allowed in JSON.
-	
-	fixedBuffer << std::endl << "]}"; // Restore the last newline and close the array.
+			// Write the bid as a JSON object.
+			file << "    {\"id\":\"" << batch[i].bidId << "\",";
+			file << "\"title\":\"" << altTitle << "\",";
+			file << "\"amount\":\"" << batch[i].amount << "\",";
+			file << "\"fund\":\"" << batch[i].fund << "\"}";
+		}
+	} while (version->NextBatch(&batch));
 
-	// Write the contents of the fixed stream to a file.
-	std::ofstream file;
-	file.open("bids.json");
-	file << fixedBuffer.str();
+	file << std::endl << "]}"; // Close the array.
 	file.close();
 }
+
 /**
  * Insert a bid
  * @param bid: The bid to insert.
+ * @return BID_INSERTED, or BID_REJECTED if the id can't be used as a key.
  */
-void BinarySearchTree::Insert(Bid bid) {
-	// Check if the root is empty. If it is, insert the bid as the root.
-	if (this->root == 0) {
-		this->root = new Node;
+StoreResult BinarySearchTree::Insert(Bid bid) {
+	uint32_t key;
 
-		addNode(this->root, bid);
+	// Bids are keyed by their numeric id, so ids that are not numbers can't be stored.
+	if (!BidStore::ParseKey(bid.bidId, &key)) {
+		return BID_REJECTED;
 	}
-	else {
-		Node* cur = this->root;
-
-		// Traverse down the tree until an empty node is found.
-		while (cur != 0) {
-			/* Choose to traverse down the left or right subtree depending on whether
-			 * the current node's bidId is greater than or less than the bidId of the
-			 * bid to insert.
-			 */
-			if (bid.bidId < cur->bid->bidId) {
-				if (cur->left == 0) {
-					cur->left = new Node;
-					addNode(cur->left, bid);
-					cur = 0;
-				}
-				else {
-					cur = cur->left;
-				}
-			}
-			else {
-				if (cur->right == 0) {
-					cur->right = new Node;
-					addNode(cur->right, bid);
-					cur = 0;
-				}
-				else {
-					cur = cur->right;
-				}
-			}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
+
+	// The wide index and frozen index are read-only copies, so any change to the tree discards them.
+	index.Clear();
+	Thaw();
+
+	insert(key, bid);
+
+	return BID_INSERTED;
+}
+
+/**
+ * Insert a bid, or replace the bid already stored under its id.
+ * @param bid: The bid to store.
+ * @return BID_INSERTED, BID_REPLACED, or BID_REJECTED if the id can't be used as a key.
+ */
+StoreResult BinarySearchTree::Upsert(Bid bid) {
+	uint32_t key;
+
+	if (!BidStore::ParseKey(bid.bidId, &key)) {
+		return BID_REJECTED;
+	}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
+
+	index.Clear();
+	Thaw();
+
+	// Record the path down to the node holding the id, if there is one.
+	std::vector<uint32_t> path;
+	std::vector<bool> rightSide;
+	uint32_t cur = this->root;
+
+	while (cur != NIL_INDEX) {
+		uint32_t curKey = bids.Key(nodes[cur].bid);
+
+		if (curKey == key) {
+			break;
 		}
+
+		path.push_back(cur);
+		rightSide.push_back(curKey < key);
+		cur = (curKey < key) ? nodes[cur].right : nodes[cur].left;
+	}
+
+	if (cur == NIL_INDEX) {
+		insert(key, bid);
+		return BID_INSERTED;
+	}
+
+	reserveBid(bid);
+
+	// With no snapshot to disturb, overwrite the stored bid in place.
+	if (pinned.empty()) {
+		bids.Set(nodes[cur].bid, bid);
+		indexBid(nodes[cur].bid);
+		update(cur);
+		this->root = relink(path, rightSide, cur);
+		return BID_REPLACED;
+	}
+
+	// Otherwise store a new bid and point a copy of the path at it.
+	uint32_t node = own(cur);
+	uint32_t oldBid = nodes[node].bid;
+
+	nodes[node].bid = bids.Add(bid);
+	update(node);
+	this->root = relink(path, rightSide, node);
+	retireBid(oldBid);
+	indexBid(nodes[node].bid);
+
+	return BID_REPLACED;
+}
+
+/**
+ * Insert a bid under a key. The caller holds the version lock.
+ * @param key: The key of the bid.
+ * @param bid: The bid to insert.
+ */
+void BinarySearchTree::insert(uint32_t key, const Bid& bid) {
+	uint32_t node = addNode(bid);
+	uint32_t rank = priority(key);
+
+	// Record the path down to the first node that ranks below the new one.
+	std::vector<uint32_t> path;
+	std::vector<bool> rightSide;
+	uint32_t cur = this->root;
+
+	while (cur != NIL_INDEX && priority(bids.Key(nodes[cur].bid)) >= rank) {
+		/* Choose to traverse down the left or right subtree depending on whether
+		 * the current node's key is greater than or less than the key of the
+		 * bid to insert.
+		 */
+		bool right = !(key < bids.Key(nodes[cur].bid));
+
+		path.push_back(cur);
+		rightSide.push_back(right);
+		cur = right ? nodes[cur].right : nodes[cur].left;
 	}
+
+	// The new node takes that node's place, with its subtree split around the new key.
+	uint32_t left;
+	uint32_t right;
+
+	split(cur, key, &left, &right);
+	nodes[node].left = left;
+	nodes[node].right = right;
+	update(node);
+
+	this->root = relink(path, rightSide, node);
 }
 
 /**
@@ -165,114 +244,307 @@ void BinarySearchTree::Insert(Bid bid) {
  * @param bidId: The id of the bid to remove.
  */
 void BinarySearchTree::Remove(std::string bidId) {
-	// Start at the root, setting the parent to NULL.
-	Node* par = 0;
-	Node* cur = this->root;
-
-	// Search down the tree until the supplied bid or an empty node is found.
-	while (cur != 0) {
-		if (cur->bid->bidId == bidId) {
-			// Procedure if the node to remove has no children.
-			if ((cur->left == 0) && (cur->right == 0)) {
-				// If the node is the root, just point it to NULL.
-				if (par == 0) {
-					this->root = 0;
-					// Free the memory that was used by this node.
-					delete cur->bid;
-					delete cur;
-				}
-				// If the node is the left child, set the parent's left pointer to NULL.
-				else if (par->left == cur) {
-					// Free the memory that was used by this node.
-					delete par->left->bid;
-					delete par->left;
-					par->left = 0;
-				}
-				// If the node is the right child set the parent's right pointer to NULL.
-				else {
-					// Free the memory that was used by this node.
-					delete par->right->bid;
-					delete par->right;
-					par->right = 0;
-				}
-			}
-			// Procedure if the node has a left child.
-			else if ((cur->left != 0) && (cur->right == 0)) {
-				// Point the root at the left child.
-				if (par == 0) {
-					// Free the memory that was used by this node.
-					delete this->root->bid;
-					delete this->root;
-					this->root = cur->left;
-				}
-				// Set the parent's left pointer as the left child of this node.
-				else if (par->left == cur) {
-					par->left = cur->left;
-					// Free the memory that was used by this node.
-					delete cur->bid;
-					delete cur;
-				}
-				// Set the parent's right pointer as the left child of this node.
-				else {
-					par->right = cur->left;
-					// Free the memory that was used by this node.
-					delete cur->bid;
-					delete cur;
-				}
-			}
-			// Procedure if the node has a right child.
-			else if ((cur->left == 0) && (cur->right != 0)) {
-				// Point the root at the right child.
-				if (par == 0) {
-					// Free the memory that was used by this node.
-					delete this->root->bid;
-					delete this->root;
-					this->root = cur->right;
-				}
-				else if (par->left == cur) {
-					par->left = cur->right;
-					// Free the memory that was used by this node.
-					delete cur->bid;
-					delete cur;
-				}
-				else {
-					par->right = cur->right;
-					// Free the memory that was used by this node.
-					delete cur->bid;
-					delete cur;
-				}
-			}
-			// Procedure if the node has two children.
-			else {
-				Node* suc = cur->right;
+	uint32_t key;
 
-				while (suc->left != 0) {
-					suc = suc->left;
-				}
+	if (!BidStore::ParseKey(bidId, &key)) {
+		return;
+	}
 
-				// Copy the successor to the current node.
-				cur->bid->bidId = suc->bid->bidId;
-				cur->bid->title = suc->bid->title;
-				cur->bid->fund = suc->bid->fund;
-				cur->bid->amount = suc->bid->amount;
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
 
-				// Recursively repeat the process.
-				Remove(bidId);
-			}
+	// Record the path down to the node holding the bid.
+	std::vector<uint32_t> path;
+	std::vector<bool> rightSide;
+	uint32_t cur = this->root;
+
+	while (cur != NIL_INDEX) {
+		uint32_t curKey = bids.Key(nodes[cur].bid);
+
+		if (curKey == key) {
+			break;
+		}
+
+		path.push_back(cur);
+		rightSide.push_back(curKey < key);
+		cur = (curKey < key) ? nodes[cur].right : nodes[cur].left;
+	}
+
+	if (cur == NIL_INDEX) {
+		return;
+	}
+
+	index.Clear();
+	Thaw();
+
+	// Splice the node's two subtrees together in its place. Nodes are relinked, never copied into.
+	uint32_t replacement = join(nodes[cur].left, nodes[cur].right);
+
+	this->root = relink(path, rightSide, replacement);
+	retireBid(nodes[cur].bid);
+	retireNode(cur);
+}
+
+/**
+ * Remove every bid with an id between two ids, inclusive.
+ * @param loBidId: The lowest id to remove.
+ * @param hiBidId: The highest id to remove.
+ * @return The number of bids removed.
+ */
+int BinarySearchTree::RemoveRange(std::string loBidId, std::string hiBidId) {
+	uint32_t lo;
+	uint32_t hi;
+
+	if (!BidStore::ParseKey(loBidId, &lo) || !BidStore::ParseKey(hiBidId, &hi) || lo > hi) {
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
+
+	index.Clear();
+	Thaw();
+
+	// Cut the tree into the ids below the range, the range, and the ids above it.
+	uint32_t below;
+	uint32_t from;
+	uint32_t range;
+	uint32_t above = NIL_INDEX;
+
+	split(this->root, lo, &below, &from);
+
+	if (hi == 0xFFFFFFFF) {
+		range = from;
+	}
+	else {
+		split(from, hi + 1, &range, &above);
+	}
+
+	// Join the outer parts back together and retire the middle.
+	this->root = join(below, above);
+
+	return retireSubtree(range);
+}
+
+/**
+ * Remove every bid matching a predicate. Every bid is tested, but subtrees
+ * with nothing removed are left untouched.
+ * @param predicate: Returns true for the bids to remove. It must not call back into the tree.
+ * @return The number of bids removed.
+ */
+int BinarySearchTree::RemoveIf(const BidPredicate& predicate) {
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
+
+	int removed = 0;
+	this->root = removeIf(this->root, predicate, &removed);
+
+	if (removed > 0) {
+		index.Clear();
+		Thaw();
+	}
+
+	return removed;
+}
+
+/**
+ * Merge the bids of another tree into this one, leaving the other tree as it
+ * was. The other tree's node pool and bid store are first appended to this
+ * tree's whole, which is linear but runs at the speed of copying arrays. Then,
+ * when every id in one tree is below every id in the other, the trees are
+ * joined along a single spine in logarithmic time; otherwise both are walked
+ * in order and the merged run is rebuilt in linear time. Where both trees hold
+ * an id, the other tree's bid replaces this tree's.
+ * @param other: The tree to merge in. It must not change during the merge.
+ */
+void BinarySearchTree::Merge(const BinarySearchTree* other) {
+	if (other == this || other->root == NIL_INDEX) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	reclaim();
+
+	index.Clear();
+	Thaw();
+
+	// Make room for the whole of the other tree at once, so appending it moves nothing afterwards.
+	{
+		std::unique_lock<std::shared_timed_mutex> growing(storageLock);
+		if (nodes.size() + other->nodes.size() > nodes.capacity()) {
+			nodes.reserve(std::max(nodes.size() + other->nodes.size(), nodes.capacity() * 2));
+		}
+		freeNodes.reserve(freeNodes.size() + other->freeNodes.size() + other->retiredNodes.size());
+		bids.Reserve(other->bids);
+	}
+
+	uint32_t imported = adopt(other);
 
-			return;
+	if (this->root == NIL_INDEX) {
+		this->root = imported;
+		return;
+	}
+
+	if (edgeKey(this->root, true) < edgeKey(imported, false)) {
+		this->root = join(this->root, imported);
+		return;
+	}
+	if (edgeKey(imported, true) < edgeKey(this->root, false)) {
+		this->root = join(imported, this->root);
+		return;
+	}
+
+	// The ranges overlap, so merge the two sorted runs.
+	std::vector<uint32_t> mine;
+	std::vector<uint32_t> theirs;
+	std::vector<uint32_t> merged;
+
+	gather(this->root, &mine);
+	gather(imported, &theirs);
+	merged.reserve(mine.size() + theirs.size());
+
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < mine.size() && j < theirs.size()) {
+		uint32_t myKey = bids.Key(nodes[mine[i]].bid);
+		uint32_t theirKey = bids.Key(nodes[theirs[j]].bid);
+
+		if (myKey < theirKey) {
+			merged.push_back(mine[i++]);
 		}
-		// Continue down the tree using the right child node.
-		else if (cur->bid->bidId < bidId) {
-			par = cur;
-			cur = cur->right;
+		else if (theirKey < myKey) {
+			merged.push_back(theirs[j++]);
 		}
-		// Continue down the tree using the left child node.
 		else {
-			par = cur;
-			cur = cur->left;
+			// The incoming bid wins; drop ours.
+			retireBid(nodes[mine[i]].bid);
+			retireNode(mine[i++]);
+		}
+	}
+
+	merged.insert(merged.end(), mine.begin() + i, mine.end());
+	merged.insert(merged.end(), theirs.begin() + j, theirs.end());
+
+	this->root = build(merged);
+}
+
+/**
+ * Append the node pool and bid store of another tree to this tree's in bulk,
+ * shifting the node and bid indexes they hold. Nodes and bids that are free or
+ * retired in the other tree are free here. The caller reserves the room first.
+ * @param other: The tree to copy.
+ * @return The root of the copy.
+ */
+uint32_t BinarySearchTree::adopt(const BinarySearchTree* other) {
+	uint32_t nodeBase = (uint32_t)nodes.size();
+	uint32_t bidBase = bids.Append(other->bids);
+
+	for (size_t i = 0; i < other->nodes.size(); i++) {
+		Node node = other->nodes[i];
+
+		node.bid += bidBase;
+		node.left = (node.left != NIL_INDEX) ? node.left + nodeBase : NIL_INDEX;
+		node.right = (node.right != NIL_INDEX) ? node.right + nodeBase : NIL_INDEX;
+		node.epoch = epoch;
+		nodes.push_back(node);
+	}
+
+	for (size_t i = 0; i < other->freeNodes.size(); i++) {
+		freeNodes.push_back(other->freeNodes[i] + nodeBase);
+	}
+	for (size_t i = 0; i < other->retiredNodes.size(); i++) {
+		freeNodes.push_back(other->retiredNodes[i].index + nodeBase);
+	}
+	for (size_t i = 0; i < other->retiredBids.size(); i++) {
+		bids.Release(other->retiredBids[i].index + bidBase);
+	}
+
+	uint32_t root = (other->root != NIL_INDEX) ? other->root + nodeBase : NIL_INDEX;
+
+	// The close date index is always kept, so it is merged a day at a time; the optional ones go bid by bid.
+	closeDates.Absorb(other->closeDates, bidBase);
+
+	if (secondaryIndexed || titleIndexed || hashIndexed) {
+		std::vector<uint32_t> order;
+		gather(root, &order);
+
+		for (size_t i = 0; i < order.size(); i++) {
+			indexOptional(nodes[order[i]].bid);
+		}
+	}
+
+	return root;
+}
+
+/**
+ * Find the smallest or largest key in a non-empty subtree.
+ * @param node: The root of the subtree.
+ * @param rightmost: True for the largest key, false for the smallest.
+ * @return The key.
+ */
+uint32_t BinarySearchTree::edgeKey(uint32_t node, bool rightmost) {
+	for (;;) {
+		uint32_t next = rightmost ? nodes[node].right : nodes[node].left;
+
+		if (next == NIL_INDEX) {
+			return bids.Key(nodes[node].bid);
+		}
+		node = next;
+	}
+}
+
+/**
+* Gather the nodes of a subtree in order.
+* @param node: The node to visit.
+* @param order: Receives the node indices.
+*/
+void BinarySearchTree::gather(uint32_t node, std::vector<uint32_t>* order) {
+	if (node == NIL_INDEX) {
+		return;
+	}
+
+	gather(nodes[node].left, order);
+	order->push_back(node);
+	gather(nodes[node].right, order);
+}
+
+/**
+ * Link nodes that are already in key order into a treap in linear time. Each
+ * node pops the lower-priority nodes off the right spine built so far and
+ * takes them as its left subtree.
+ * @param order: The nodes in key order.
+ * @return The root of the new treap.
+ */
+uint32_t BinarySearchTree::build(const std::vector<uint32_t>& order) {
+	std::vector<uint32_t> spine;
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t node = own(order[i]);
+		uint32_t rank = priority(bids.Key(nodes[node].bid));
+		uint32_t last = NIL_INDEX;
+
+		// A node leaving the spine has its final children, so its totals can be computed.
+		while (!spine.empty() && priority(bids.Key(nodes[spine.back()].bid)) < rank) {
+			last = spine.back();
+			spine.pop_back();
+			update(last);
+		}
+
+		nodes[node].left = last;
+		nodes[node].right = NIL_INDEX;
+
+		if (!spine.empty()) {
+			nodes[spine.back()].right = node;
 		}
+		spine.push_back(node);
+	}
+
+	for (size_t i = spine.size(); i-- > 0;) {
+		update(spine[i]);
 	}
+
+	return spine.empty() ? NIL_INDEX : spine.front();
 }
 
 /**
@@ -281,21 +553,46 @@ void BinarySearchTree::Remove(std::string bidId) {
  * @return If the bid exists, it is returned. Otherwise, an empty bid is returned.
  */
 Bid BinarySearchTree::Search(std::string bidId) {
+	uint32_t key;
+
+	if (!BidStore::ParseKey(bidId, &key)) {
+		return Bid();
+	}
+
+	// Use the hash index, the frozen index or the wide index when one has been built.
+	if (hashIndexed) {
+		uint32_t handle = hashIndex.Find(key);
+
+		return (handle != NIL_INDEX) ? bids.Get(handle) : Bid();
+	}
+	if (frozen) {
+		uint32_t handle = frozenIndex.Find(key);
+
+		return (handle != NIL_INDEX) ? bids.Get(handle) : Bid();
+	}
+	if (!index.Empty()) {
+		uint32_t handle = index.Find(key);
+
+		return (handle != NIL_INDEX) ? bids.Get(handle) : Bid();
+	}
+
 	// Start at the root.
-	Node* cur = this->root;
+	uint32_t cur = this->root;
 
 	// Traverse down through the tree until the provided bid or an empty leaf is found.
-	while (cur != 0) {
-		// If the bidId matches return the info.
-		if (cur->bid->bidId == bidId) {
-			return *cur->bid;
+	while (cur != NIL_INDEX) {
+		uint32_t curKey = bids.Key(nodes[cur].bid);
+
+		// If the key matches return the info.
+		if (curKey == key) {
+			return bids.Get(nodes[cur].bid);
 		}
-		// Otherwise compare the value of the node's bidId to provided Id and proceed down left or right.
-		else if (cur->bid->bidId > bidId) {
-			cur = cur->left;
+		// Otherwise compare the value of the node's key to provided key and proceed down left or right.
+		else if (curKey > key) {
+			cur = nodes[cur].left;
 		}
 		else {
-			cur = cur->right;
+			cur = nodes[cur].right;
 		}
 	}
 
@@ -305,104 +602,1161 @@ Bid BinarySearchTree::Search(std::string bidId) {
 }
 
 /**
- * Add a bid to some node (recursive)
- *
- * @param node Current node in tree
- * @param bid Bid to be added
+ * Search for many bids at once. Lookups run in groups, each advancing one step
+ * per pass, so the cache misses of different lookups overlap instead of
+ * queueing up behind each other.
+ * @param bidIds: Ids to search for.
+ * @param handles: Receives the bid handle for each id, or NIL_INDEX if it was not found.
+ *                 Read the bids through Bids() without copying them.
  */
-void BinarySearchTree::addNode(Node* node, Bid bid) {
-	// Allocate memory for a bid and copy the provided info to it.
-	Bid* newBid = new Bid;
+void BinarySearchTree::SearchBatch(const std::vector<std::string>& bidIds, std::vector<uint32_t>* handles) {
+	const size_t GROUP_SIZE = 16;
 
-	newBid->bidId = bid.bidId;
-	newBid->title = bid.title;
-	newBid->fund = bid.fund;
-	newBid->amount = bid.amount;
+	// The state of one lookup. It alternates between reading a node and reading its key.
+	struct Lookup {
+		uint32_t key;
+		uint32_t node;
+		uint32_t bid;
+		bool keyPending;
+	};
 
-	// Point the provided node at the new bid.
-	node->bid = newBid;
+	handles->assign(bidIds.size(), NIL_INDEX);
 
-	// Initialize the node's child pointers.
-	node->left = 0;
-	node->right = 0;
-}
+	// A hash lookup is one probe, so prefetching a group's first line ahead of it is enough.
+	if (hashIndexed) {
+		std::vector<uint32_t> keys(bidIds.size(), 0);
+		std::vector<bool> valid(bidIds.size(), false);
 
-/**
-* Print out info about every bid in the tree, in order.
-* @param node: The node to visit.
-*/
-void BinarySearchTree::inOrder(Node* node) {
-	// Recursively visit each node in the tree, printing the bid's info.
-	if (node == 0) {
+		for (size_t i = 0; i < bidIds.size(); i++) {
+			valid[i] = BidStore::ParseKey(bidIds[i], &keys[i]);
+			if (valid[i]) {
+				BST::prefetch(hashIndex.GroupAddress(keys[i]));
+			}
+		}
+
+		for (size_t i = 0; i < bidIds.size(); i++) {
+			if (valid[i]) {
+				(*handles)[i] = hashIndex.Find(keys[i]);
+			}
+		}
 		return;
 	}
 
-	inOrder(node->left);
-	BST::displayBid(*node->bid);
-	inOrder(node->right);
-}
+	for (size_t start = 0; start < bidIds.size(); start += GROUP_SIZE) {
+		Lookup group[GROUP_SIZE];
+		size_t groupSize = std::min(GROUP_SIZE, bidIds.size() - start);
+		size_t active = 0;
 
-/**
-* Recursively prints out each of the bids to a JSON array in order of ID (private method).
-* @param node: The node to visit.
-* @param buffer: The stringstream to print to.
-*/
-void BinarySearchTree::inOrderJSON(Node* node, std::stringstream* buffer)
-{
-	if (node == 0) {
-		return;
-	}
+		for (size_t i = 0; i < groupSize; i++) {
+			group[i].node = NIL_INDEX;
+			group[i].keyPending = false;
+
+			if (!BidStore::ParseKey(bidIds[start + i], &group[i].key)) {
+				continue;
+			}
+
+			// The read-only copies already prefetch within a single lookup.
+			if (frozen) {
+				(*handles)[start + i] = frozenIndex.Find(group[i].key);
+			}
+			else if (!index.Empty()) {
+				(*handles)[start + i] = index.Find(group[i].key);
+			}
+			else if (this->root != NIL_INDEX) {
+				group[i].node = this->root;
+				BST::prefetch(&nodes[this->root]);
+				++active;
+			}
+		}
+
+		while (active > 0) {
+			for (size_t i = 0; i < groupSize; i++) {
+				Lookup& lookup = group[i];
+
+				if (lookup.node == NIL_INDEX) {
+					continue;
+				}
 
-	inOrderJSON(node->left, buffer);
+				// The node was prefetched on the last pass; now fetch the key it points at.
+				if (!lookup.keyPending) {
+					lookup.bid = nodes[lookup.node].bid;
+					BST::prefetch(bids.KeyAddress(lookup.bid));
+					lookup.keyPending = true;
+					continue;
+				}
 
-	std::string altTitle = fixQuotes(node->bid->title);
+				uint32_t curKey = bids.Key(lookup.bid);
+				lookup.keyPending = false;
 
-	// Write the current bid to the stream as a JSON object.
-	*buffer << "    {\"id\":\"" << node->bid->bidId << "\",";
-	*buffer << "\"title\":\"" << altTitle << "\",";
-	*buffer << "\"amount\":\"" << node->bid->amount << "\",";
-	*buffer << "\"fund\":\"" << node->bid->fund << "\"}," << std::endl;
+				if (curKey == lookup.key) {
+					(*handles)[start + i] = lookup.bid;
+					lookup.node = NIL_INDEX;
+				}
+				else {
+					lookup.node = (curKey > lookup.key) ? nodes[lookup.node].left : nodes[lookup.node].right;
+				}
 
-	inOrderJSON(node->right, buffer);
+				if (lookup.node == NIL_INDEX) {
+					--active;
+				}
+				else {
+					BST::prefetch(&nodes[lookup.node]);
+				}
+			}
+		}
+	}
 }
 
 /**
-* Get size of tree in nodes. Private version.
-* @param node: The node to visit.
-* @return The number of nodes as an integer.
-*/
-int BinarySearchTree::size(Node* node) {
-	// Count the number of nodes in the tree by visiting each one and incrementing a counter.
-	int count = 0;
+ * Get the store holding every bid, to read the results of SearchBatch.
+ * @return The bid store.
+ */
+const BidStore& BinarySearchTree::Bids() {
+	return bids;
+}
 
-	if (node == 0) {
-		return count;
+/**
+ * Get the id of every bid in order.
+ * @return The bid ids.
+ */
+std::vector<std::string> BinarySearchTree::BidIds() {
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> handles;
+	std::vector<std::string> bidIds;
+
+	collect(this->root, &keys, &handles);
+
+	bidIds.reserve(keys.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		bidIds.push_back(std::to_string(keys[i]));
 	}
-	// Recurse through each subtree, returning accumulated count.
-	count = count + size(node->left);
-	++count;
-	count = count + size(node->right);
 
-	return count;
+	return bidIds;
 }
 
 /**
-* Get size of tree in nodes. Public version.
-* @return The number of nodes as an integer.
+ * Store a bid and allocate a node for it.
+ *
+ * @param bid Bid to be added
+ * @return The index of the new node.
+ */
+uint32_t BinarySearchTree::addNode(const Bid& bid) {
+	uint32_t node = allocNode();
+
+	reserveBid(bid);
+
+	// Copy the bid into the store and point the node at it.
+	nodes[node].bid = bids.Add(bid);
+	indexBid(nodes[node].bid);
+
+	// Initialize the node's child indices.
+	nodes[node].left = NIL_INDEX;
+	nodes[node].right = NIL_INDEX;
+	update(node);
+
+	return node;
+}
+
+/**
+ * Rank a key for the heap order of the tree. Hashing the key, rather than
+ * using the order bids arrive in, keeps the tree balanced for sorted input.
+ * @param key: The key of a bid.
+ * @return The priority of the node holding the key.
+ */
+uint32_t BinarySearchTree::priority(uint32_t key) {
+	key ^= key >> 16;
+	key *= 0x85EBCA6B;
+	key ^= key >> 13;
+	key *= 0xC2B2AE35;
+	key ^= key >> 16;
+
+	return key;
+}
+
+/**
+ * Split a subtree into the nodes with keys below a key and the rest.
+ * @param node: The root of the subtree.
+ * @param key: The first key of the right part.
+ * @param left: Receives the root of the nodes with smaller keys.
+ * @param right: Receives the root of the other nodes.
+ */
+void BinarySearchTree::split(uint32_t node, uint32_t key, uint32_t* left, uint32_t* right) {
+	if (node == NIL_INDEX) {
+		*left = NIL_INDEX;
+		*right = NIL_INDEX;
+		return;
+	}
+
+	uint32_t lower;
+	uint32_t upper;
+
+	node = own(node);
+
+	if (bids.Key(nodes[node].bid) < key) {
+		// The node and its left subtree go left; split its right subtree.
+		split(nodes[node].right, key, &lower, &upper);
+		nodes[node].right = lower;
+		update(node);
+		*left = node;
+		*right = upper;
+	}
+	else {
+		split(nodes[node].left, key, &lower, &upper);
+		nodes[node].left = upper;
+		update(node);
+		*left = lower;
+		*right = node;
+	}
+}
+
+/**
+ * Join two subtrees where every key on the left is below every key on the right.
+ * @param left: The root of the subtree with smaller keys.
+ * @param right: The root of the subtree with larger keys.
+ * @return The root of the joined subtree.
+ */
+uint32_t BinarySearchTree::join(uint32_t left, uint32_t right) {
+	if (left == NIL_INDEX) {
+		return right;
+	}
+	if (right == NIL_INDEX) {
+		return left;
+	}
+
+	// The higher-priority root stays on top; join beneath it along the facing spine.
+	if (priority(bids.Key(nodes[left].bid)) >= priority(bids.Key(nodes[right].bid))) {
+		left = own(left);
+		uint32_t joined = join(nodes[left].right, right);
+		nodes[left].right = joined;
+		update(left);
+		return left;
+	}
+	else {
+		right = own(right);
+		uint32_t joined = join(left, nodes[right].left);
+		nodes[right].left = joined;
+		update(right);
+		return right;
+	}
+}
+
+/**
+ * Retire every node and bid in a subtree that has been cut out of the tree.
+ * @param node: The root of the subtree.
+ * @return The number of nodes retired.
+ */
+int BinarySearchTree::retireSubtree(uint32_t node) {
+	std::vector<uint32_t> stack;
+	int count = 0;
+
+	if (node != NIL_INDEX) {
+		stack.push_back(node);
+	}
+
+	while (!stack.empty()) {
+		uint32_t cur = stack.back();
+		stack.pop_back();
+
+		if (nodes[cur].left != NIL_INDEX) {
+			stack.push_back(nodes[cur].left);
+		}
+		if (nodes[cur].right != NIL_INDEX) {
+			stack.push_back(nodes[cur].right);
+		}
+
+		retireBid(nodes[cur].bid);
+		retireNode(cur);
+		++count;
+	}
+
+	return count;
+}
+
+/**
+ * Remove the bids matching a predicate from a subtree.
+ * @param node: The root of the subtree.
+ * @param predicate: Returns true for the bids to remove.
+ * @param removed: Incremented for each bid removed.
+ * @return The root of the subtree afterwards.
+ */
+uint32_t BinarySearchTree::removeIf(uint32_t node, const BidPredicate& predicate, int* removed) {
+	if (node == NIL_INDEX) {
+		return node;
+	}
+
+	int before = *removed;
+	uint32_t left = removeIf(nodes[node].left, predicate, removed);
+	uint32_t right = removeIf(nodes[node].right, predicate, removed);
+
+	if (predicate(bids, nodes[node].bid)) {
+		uint32_t joined = join(left, right);
+
+		retireBid(nodes[node].bid);
+		retireNode(node);
+		++*removed;
+
+		return joined;
+	}
+
+	// Only copy or write the node if one of its subtrees changed.
+	if (*removed != before) {
+		node = own(node);
+		nodes[node].left = left;
+		nodes[node].right = right;
+		update(node);
+	}
+
+	return node;
+}
+
+/**
+ * Make room in the store for a bid before it is written.
+ * @param bid: The bid about to be stored.
+ */
+void BinarySearchTree::reserveBid(const Bid& bid) {
+	// Growing the store may move its columns, so keep snapshot readers out meanwhile.
+	if (bids.NeedsGrowth(bid)) {
+		std::unique_lock<std::shared_timed_mutex> growing(storageLock);
+		bids.Grow(bid);
+	}
+}
+
+/**
+ * Allocate a node, reusing a freed node when possible.
+ * @return The index of the node, stamped with the current epoch.
+ */
+uint32_t BinarySearchTree::allocNode() {
+	uint32_t node;
+
+	if (!freeNodes.empty()) {
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		// Growing the pool moves it, so keep snapshot readers out meanwhile.
+		if (nodes.size() == nodes.capacity()) {
+			std::unique_lock<std::shared_timed_mutex> growing(storageLock);
+			nodes.reserve(std::max<size_t>(64, nodes.capacity() * 2));
+		}
+
+		node = (uint32_t)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	nodes[node].epoch = epoch;
+
+	return node;
+}
+
+/**
+ * Get a node that can be changed without disturbing any snapshot. Nodes a
+ * snapshot may be reading are copied, and the original is retired.
+ * @param node: The index of the node to change.
+ * @return The index of the node to write to.
+ */
+uint32_t BinarySearchTree::own(uint32_t node) {
+	// Nodes stamped after the newest snapshot was taken are not visible to any snapshot.
+	if (pinned.empty() || nodes[node].epoch > pinned.rbegin()->first) {
+		return node;
+	}
+
+	uint32_t copy = allocNode();
+
+	nodes[copy].bid = nodes[node].bid;
+	nodes[copy].left = nodes[node].left;
+	nodes[copy].right = nodes[node].right;
+	nodes[copy].total = nodes[node].total;
+	retireNode(node);
+
+	return copy;
+}
+
+/**
+ * An aggregate over no bids.
+ * @return The empty aggregate.
+ */
+Aggregate BinarySearchTree::none() {
+	Aggregate empty = { 0, 0.0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+
+	return empty;
+}
+
+/**
+ * Fold one aggregate into another.
+ * @param total: The aggregate to add to.
+ * @param part: The aggregate to add.
+ */
+void BinarySearchTree::combine(Aggregate* total, const Aggregate& part) {
+	total->count += part.count;
+	total->sum += part.sum;
+	total->min = std::min(total->min, part.min);
+	total->max = std::max(total->max, part.max);
+}
+
+/**
+ * Get the totals of a subtree.
+ * @param node: The root of the subtree, or NIL_INDEX.
+ * @return The subtree's aggregate.
+ */
+Aggregate BinarySearchTree::totalOf(uint32_t node) {
+	return node == NIL_INDEX ? none() : nodes[node].total;
+}
+
+/**
+ * Recompute a node's totals from its own bid and its children's totals.
+ * @param node: The node whose children or bid changed.
+ */
+void BinarySearchTree::update(uint32_t node) {
+	double amount = bids.Amount(nodes[node].bid);
+	Aggregate total = { 1, amount, amount, amount };
+
+	combine(&total, totalOf(nodes[node].left));
+	combine(&total, totalOf(nodes[node].right));
+	nodes[node].total = total;
+}
+
+/**
+ * Point the last node of a path at a new child and bring the totals along the
+ * path up to date, copying nodes where a snapshot could see the change.
+ * @param path: The nodes from the top of the path down to the parent.
+ * @param rightSide: Whether each step of the path went to the right child.
+ * @param child: The new child of the last node.
+ * @return The index of the top of the path after the change.
+ */
+uint32_t BinarySearchTree::relink(const std::vector<uint32_t>& path, const std::vector<bool>& rightSide, uint32_t child) {
+	for (size_t i = path.size(); i-- > 0;) {
+		uint32_t parent = own(path[i]);
+
+		if (rightSide[i]) {
+			nodes[parent].right = child;
+		}
+		else {
+			nodes[parent].left = child;
+		}
+
+		// Every ancestor's totals change, so the walk goes all the way up even when nothing is copied.
+		update(parent);
+		child = parent;
+	}
+
+	return child;
+}
+
+/**
+ * Free a node, or hold it until every snapshot that could see it is released.
+ * @param node: The index of the node.
+ */
+void BinarySearchTree::retireNode(uint32_t node) {
+	if (pinned.empty()) {
+		freeNodes.push_back(node);
+		return;
+	}
+
+	Retired retired = { node, epoch };
+	retiredNodes.push_back(retired);
+}
+
+/**
+ * Free a bid, or hold it until every snapshot that could see it is released.
+ * @param bid: The handle of the bid.
+ */
+void BinarySearchTree::retireBid(uint32_t bid) {
+	// The bid leaves the current tree now, even if a snapshot keeps reading it.
+	closeDates.Remove(bid);
+
+	if (secondaryIndexed) {
+		secondary.Remove(bid);
+	}
+	if (titleIndexed) {
+		titles.Remove(bid);
+	}
+	if (hashIndexed) {
+		hashIndex.Erase(bids.Key(bid), bid);
+	}
+
+	if (pinned.empty()) {
+		bids.Release(bid);
+		return;
+	}
+
+	Retired retired = { bid, epoch };
+	retiredBids.push_back(retired);
+}
+
+/**
+ * Add a stored bid to the close date index, and to the secondary, title and
+ * hash indexes if they are built, replacing its old entries.
+ * @param bid: The handle of the bid.
+ */
+void BinarySearchTree::indexBid(uint32_t bid) {
+	closeDates.Add(bid, bids.CloseDate(bid), bids.Amount(bid));
+	indexOptional(bid);
+}
+
+/**
+ * Add a stored bid to the secondary, title and hash indexes that are built,
+ * replacing its old entries.
+ * @param bid: The handle of the bid.
+ */
+void BinarySearchTree::indexOptional(uint32_t bid) {
+	if (secondaryIndexed) {
+		secondary.Add(bid, bids.FundCode(bid), bids.Amount(bid));
+	}
+	if (titleIndexed) {
+		titles.Add(bid, bids);
+	}
+	if (hashIndexed) {
+		hashIndex.Insert(bids.Key(bid), bid);
+	}
+}
+
+/**
+ * Free the retired nodes and bids that no remaining snapshot can see.
+ */
+void BinarySearchTree::reclaim() {
+	// Something retired in epoch R is visible only to snapshots taken before R.
+	while (!retiredNodes.empty() && (pinned.empty() || retiredNodes.front().epoch <= pinned.begin()->first)) {
+		freeNodes.push_back(retiredNodes.front().index);
+		retiredNodes.pop_front();
+	}
+
+	while (!retiredBids.empty() && (pinned.empty() || retiredBids.front().epoch <= pinned.begin()->first)) {
+		bids.Release(retiredBids.front().index);
+		retiredBids.pop_front();
+	}
+}
+
+/**
+ * Take a read-only snapshot of the tree. It may be read from any thread
+ * while this tree keeps changing, and must be released before the tree is destroyed.
+ * @return The snapshot.
+ */
+std::shared_ptr<TreeSnapshot> BinarySearchTree::Snapshot() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	pinned[epoch]++;
+	std::shared_ptr<TreeSnapshot> version(new TreeSnapshot(this, this->root, epoch));
+
+	// Everything stamped up to now may be visible to the snapshot; later nodes are not.
+	++epoch;
+
+	return version;
+}
+
+/**
+ * Release a snapshot. Its nodes are reclaimed by the next change to the tree.
+ * @param snapshotEpoch: The epoch the snapshot was taken in.
+ */
+void BinarySearchTree::releaseSnapshot(uint32_t snapshotEpoch) {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	std::map<uint32_t, int>::iterator it = pinned.find(snapshotEpoch);
+
+	if (--it->second == 0) {
+		pinned.erase(it);
+	}
+}
+
+/**
+* Get size of tree in nodes. Private version.
+* @param node: The node to visit.
+* @return The number of nodes as an integer.
+*/
+int BinarySearchTree::size(uint32_t node) {
+	// Count the number of nodes in the tree by visiting each one and incrementing a counter.
+	int count = 0;
+
+	if (node == NIL_INDEX) {
+		return count;
+	}
+	// Recurse through each subtree, returning accumulated count.
+	count = count + size(nodes[node].left);
+	++count;
+	count = count + size(nodes[node].right);
+
+	return count;
+}
+
+/**
+* Get size of tree in nodes. Public version.
+* @return The number of nodes as an integer.
 */
 int BinarySearchTree::Size() {
 	// Count the number of nodes in the tree by visiting each one and incrementing a counter.
-	Node* node = this->root;
+	uint32_t node = this->root;
 
 	int count = 0;
 
-	if (node == 0) {
+	if (node == NIL_INDEX) {
 		return count;
 	}
 	// Recurse through each subtree, returning accumulated count.
-	count = count + size(node->left);
+	count = count + size(nodes[node].left);
 	++count;
-	count = count + size(node->right);
+	count = count + size(nodes[node].right);
 
 	return count;
-}
\ No newline at end of file
+}
+
+/**
+* Gather the keys and bid handles of a subtree in order.
+* @param node: The node to visit.
+* @param keys: Receives the keys.
+* @param handles: Receives the bid handles.
+*/
+void BinarySearchTree::collect(uint32_t node, std::vector<uint32_t>* keys, std::vector<uint32_t>* handles) {
+	if (node == NIL_INDEX) {
+		return;
+	}
+
+	collect(nodes[node].left, keys, handles);
+	keys->push_back(bids.Key(nodes[node].bid));
+	handles->push_back(nodes[node].bid);
+	collect(nodes[node].right, keys, handles);
+}
+
+/**
+* Build a read-only wide index over the current keys. Search uses it until
+* the tree is next changed.
+*/
+void BinarySearchTree::BuildIndex() {
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> handles;
+
+	keys.reserve(bids.Count());
+	handles.reserve(bids.Count());
+	collect(this->root, &keys, &handles);
+
+	index.Build(keys, handles);
+}
+
+/**
+* Freeze the tree for lookup-heavy use. Search then runs against a pointer-free
+* Eytzinger copy of the keys until the tree is thawed. Insert and Remove thaw
+* the tree before changing it.
+*/
+void BinarySearchTree::Freeze() {
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> handles;
+
+	keys.reserve(bids.Count());
+	handles.reserve(bids.Count());
+	collect(this->root, &keys, &handles);
+
+	frozenIndex.Build(keys, handles);
+	frozen = true;
+}
+
+/**
+* Discard the frozen index and go back to searching the tree itself.
+*/
+void BinarySearchTree::Thaw() {
+	if (!frozen) {
+		return;
+	}
+
+	frozenIndex.Clear();
+	frozen = false;
+}
+
+/**
+* Check whether the tree is frozen.
+* @return True if Search is using the frozen index.
+*/
+bool BinarySearchTree::IsFrozen() {
+	return frozen;
+}
+
+/**
+* Sum the amount of every bid in the tree. Bids removed while a snapshot is
+* held still count until the snapshot is released.
+* @return The total amount.
+*/
+double BinarySearchTree::TotalAmount() {
+	// The amount column is contiguous, so no traversal is needed.
+	return bids.SumAmounts();
+}
+
+/**
+* Estimate the heap memory used by the tree.
+* @return The number of bytes held by the node pool and the bid store.
+*/
+size_t BinarySearchTree::MemoryUsage() {
+	return nodes.capacity() * sizeof(Node)
+		+ freeNodes.capacity() * sizeof(uint32_t)
+		+ (retiredNodes.size() + retiredBids.size()) * sizeof(Retired)
+		+ bids.MemoryUsage()
+		+ index.MemoryUsage()
+		+ frozenIndex.MemoryUsage()
+		+ secondary.MemoryUsage()
+		+ closeDates.MemoryUsage()
+		+ titles.MemoryUsage()
+		+ hashIndex.MemoryUsage();
+}
+
+/**
+* Index every bid by fund and by amount. The indexes are kept up to date as
+* the tree changes, until they are dropped.
+*/
+void BinarySearchTree::BuildSecondaryIndexes() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	std::vector<uint32_t> order;
+	gather(this->root, &order);
+
+	secondary.Clear();
+	secondaryIndexed = true;
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t bid = nodes[order[i]].bid;
+		secondary.Add(bid, bids.FundCode(bid), bids.Amount(bid));
+	}
+}
+
+/**
+* Discard the secondary indexes. Fund and amount queries then scan the tree.
+*/
+void BinarySearchTree::DropSecondaryIndexes() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	secondary.Clear();
+	secondaryIndexed = false;
+}
+
+/**
+* Check whether the secondary indexes are built.
+* @return True if fund and amount queries use the indexes.
+*/
+bool BinarySearchTree::HasSecondaryIndexes() {
+	return secondaryIndexed;
+}
+
+/**
+* Find every bid in a fund.
+* @param fund: The fund to look for.
+* @return Copies of the bids, in no particular order when the indexes are built and in id order otherwise.
+*/
+std::vector<Bid> BinarySearchTree::FindByFund(std::string fund) {
+	std::lock_guard<std::mutex> guard(versionLock);
+	std::vector<Bid> found;
+	uint32_t code;
+
+	// A fund that was never interned has no bids, and every other comparison is between codes.
+	if (!bids.Labels().Find(fund, &code)) {
+		return found;
+	}
+
+	if (!secondaryIndexed) {
+		return scan([code](const BidStore& store, uint32_t handle) {
+			return store.FundCode(handle) == code;
+		});
+	}
+
+	const std::vector<uint32_t>* postings = secondary.Fund(code);
+
+	if (postings != nullptr) {
+		found.reserve(postings->size());
+
+		for (size_t i = 0; i < postings->size(); i++) {
+			found.push_back(bids.Get((*postings)[i]));
+		}
+	}
+
+	return found;
+}
+
+/**
+* Find every bid with an amount in a range.
+* @param lo: The smallest amount to include.
+* @param hi: The largest amount to include.
+* @return Copies of the bids, in order of amount when the indexes are built and in id order otherwise.
+*/
+std::vector<Bid> BinarySearchTree::FindByAmount(double lo, double hi) {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	if (!secondaryIndexed) {
+		return scan([lo, hi](const BidStore& store, uint32_t handle) {
+			return store.Amount(handle) >= lo && store.Amount(handle) <= hi;
+		});
+	}
+
+	std::vector<Bid> found;
+	std::vector<uint32_t> handles;
+
+	secondary.AmountRange(lo, hi, &handles);
+	found.reserve(handles.size());
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		found.push_back(bids.Get(handles[i]));
+	}
+
+	return found;
+}
+
+/**
+* Walk the whole tree for the bids matching a predicate. The caller holds versionLock.
+* @param predicate: The test to apply to each bid.
+* @return Copies of the matching bids in id order.
+*/
+std::vector<Bid> BinarySearchTree::scan(const BidPredicate& predicate) {
+	std::vector<uint32_t> order;
+	std::vector<Bid> found;
+
+	gather(this->root, &order);
+
+	for (size_t i = 0; i < order.size(); i++) {
+		if (predicate(bids, nodes[order[i]].bid)) {
+			found.push_back(bids.Get(nodes[order[i]].bid));
+		}
+	}
+
+	return found;
+}
+
+/**
+* Summarize the amounts of the bids with ids in a range. Only the two paths to
+* the ends of the range are walked; subtrees wholly inside it contribute their
+* totals.
+* @param loBidId: The lowest id in the range.
+* @param hiBidId: The highest id in the range.
+* @return The count, sum, minimum and maximum amount.
+*/
+Aggregate BinarySearchTree::AmountsInRange(std::string loBidId, std::string hiBidId) {
+	uint32_t lo;
+	uint32_t hi;
+	Aggregate total = none();
+
+	if (!BidStore::ParseKey(loBidId, &lo) || !BidStore::ParseKey(hiBidId, &hi) || lo > hi) {
+		return total;
+	}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	uint32_t node = this->root;
+
+	// Descend to the first node inside the range; the paths to each end fork there.
+	while (node != NIL_INDEX) {
+		uint32_t key = bids.Key(nodes[node].bid);
+
+		if (key < lo) {
+			node = nodes[node].right;
+		}
+		else if (key > hi) {
+			node = nodes[node].left;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (node == NIL_INDEX) {
+		return total;
+	}
+
+	double amount = bids.Amount(nodes[node].bid);
+	Aggregate self = { 1, amount, amount, amount };
+	combine(&total, self);
+
+	// Down the left side, everything right of a node at or above lo is in range.
+	for (uint32_t cur = nodes[node].left; cur != NIL_INDEX;) {
+		if (bids.Key(nodes[cur].bid) >= lo) {
+			amount = bids.Amount(nodes[cur].bid);
+			Aggregate part = { 1, amount, amount, amount };
+			combine(&total, part);
+			combine(&total, totalOf(nodes[cur].right));
+			cur = nodes[cur].left;
+		}
+		else {
+			cur = nodes[cur].right;
+		}
+	}
+
+	// And down the right side, everything left of a node at or below hi.
+	for (uint32_t cur = nodes[node].right; cur != NIL_INDEX;) {
+		if (bids.Key(nodes[cur].bid) <= hi) {
+			amount = bids.Amount(nodes[cur].bid);
+			Aggregate part = { 1, amount, amount, amount };
+			combine(&total, part);
+			combine(&total, totalOf(nodes[cur].left));
+			cur = nodes[cur].right;
+		}
+		else {
+			cur = nodes[cur].left;
+		}
+	}
+
+	return total;
+}
+
+/**
+* Sum the amounts of the bids with ids in a range.
+* @param loBidId: The lowest id in the range.
+* @param hiBidId: The highest id in the range.
+* @return The total amount.
+*/
+double BinarySearchTree::SumRange(std::string loBidId, std::string hiBidId) {
+	return AmountsInRange(loBidId, hiBidId).sum;
+}
+
+/**
+* Find the largest amount among the bids with ids in a range.
+* @param loBidId: The lowest id in the range.
+* @param hiBidId: The highest id in the range.
+* @return The largest amount, or minus infinity if the range holds no bids.
+*/
+double BinarySearchTree::MaxInRange(std::string loBidId, std::string hiBidId) {
+	return AmountsInRange(loBidId, hiBidId).max;
+}
+
+/**
+* Find the bids with the largest amounts. Subtrees are visited best first by
+* their largest amount, so a subtree is never opened unless it holds one of
+* the results.
+* @param count: The number of bids to return.
+* @return Copies of the bids, largest amount first.
+*/
+std::vector<Bid> BinarySearchTree::TopByAmount(size_t count) {
+	// A candidate is either a whole subtree, ranked by its largest amount, or a single node's bid.
+	struct Candidate {
+		double amount;
+		uint32_t node;
+		bool subtree;
+
+		bool operator<(const Candidate& other) const { return amount < other.amount; }
+	};
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	std::priority_queue<Candidate> frontier;
+	std::vector<Bid> top;
+
+	if (this->root != NIL_INDEX) {
+		Candidate start = { nodes[this->root].total.max, this->root, true };
+		frontier.push(start);
+	}
+
+	while (top.size() < count && !frontier.empty()) {
+		Candidate best = frontier.top();
+		frontier.pop();
+
+		if (!best.subtree) {
+			top.push_back(bids.Get(nodes[best.node].bid));
+			continue;
+		}
+
+		const Node& node = nodes[best.node];
+		Candidate self = { bids.Amount(node.bid), best.node, false };
+		frontier.push(self);
+
+		if (node.left != NIL_INDEX) {
+			Candidate left = { nodes[node.left].total.max, node.left, true };
+			frontier.push(left);
+		}
+		if (node.right != NIL_INDEX) {
+			Candidate right = { nodes[node.right].total.max, node.right, true };
+			frontier.push(right);
+		}
+	}
+
+	return top;
+}
+
+/**
+* Find every bid that closed in a range of dates.
+* @param fromDate: The first day of the range, as month/day/year.
+* @param toDate: The last day of the range, as month/day/year.
+* @return Copies of the bids in order of close date.
+*/
+std::vector<Bid> BinarySearchTree::ClosedBetween(std::string fromDate, std::string toDate) {
+	int32_t from = BST::parseDate(fromDate);
+	int32_t to = BST::parseDate(toDate);
+	std::vector<Bid> found;
+
+	if (from == NO_DATE || to == NO_DATE) {
+		return found;
+	}
+
+	std::lock_guard<std::mutex> guard(versionLock);
+	std::vector<uint32_t> handles;
+
+	closeDates.Between(from, to, &handles);
+	found.reserve(handles.size());
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		found.push_back(bids.Get(handles[i]));
+	}
+
+	return found;
+}
+
+/**
+* Get the number and total amount of the bids that closed on each day of a range.
+* @param fromDate: The first day of the range, as month/day/year.
+* @param toDate: The last day of the range, as month/day/year.
+* @return One rollup for each day with bids, in date order.
+*/
+std::vector<Rollup> BinarySearchTree::DailyTotals(std::string fromDate, std::string toDate) {
+	int32_t from = BST::parseDate(fromDate);
+	int32_t to = BST::parseDate(toDate);
+	std::vector<Rollup> rollups;
+
+	if (from != NO_DATE && to != NO_DATE) {
+		std::lock_guard<std::mutex> guard(versionLock);
+		closeDates.Days(from, to, &rollups);
+	}
+
+	return rollups;
+}
+
+/**
+* Get the number and total amount of the bids that closed in each week of a
+* range. Weeks start on Monday and are counted whole.
+* @param fromDate: A day in the first week, as month/day/year.
+* @param toDate: A day in the last week, as month/day/year.
+* @return One rollup for each week with bids, in date order, dated by its Monday.
+*/
+std::vector<Rollup> BinarySearchTree::WeeklyTotals(std::string fromDate, std::string toDate) {
+	int32_t from = BST::parseDate(fromDate);
+	int32_t to = BST::parseDate(toDate);
+	std::vector<Rollup> rollups;
+
+	if (from != NO_DATE && to != NO_DATE) {
+		std::lock_guard<std::mutex> guard(versionLock);
+		closeDates.Weeks(from, to, &rollups);
+	}
+
+	return rollups;
+}
+
+/**
+* Index every bid by title for prefix and substring lookups. Built on an empty
+* tree, the index fills in as bids are loaded. It is kept up to date as the
+* tree changes, until it is dropped.
+*/
+void BinarySearchTree::BuildTitleIndex() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	std::vector<uint32_t> order;
+	gather(this->root, &order);
+
+	titles.Clear();
+	titleIndexed = true;
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t bid = nodes[order[i]].bid;
+		titles.Add(bid, bids);
+	}
+}
+
+/**
+* Discard the title index. Title lookups then scan the tree.
+*/
+void BinarySearchTree::DropTitleIndex() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	titles.Clear();
+	titleIndexed = false;
+}
+
+/**
+* Check whether the title index is built.
+* @return True if title lookups use the index.
+*/
+bool BinarySearchTree::HasTitleIndex() {
+	return titleIndexed;
+}
+
+/**
+* Find the bids whose titles start with some text, ignoring case. The handles
+* can be read through Bids() until the tree next changes.
+* @param prefix: The text to look for.
+* @param handles: Receives the handles, in title order when the index is built and in id order otherwise.
+*/
+void BinarySearchTree::FindByTitlePrefix(const std::string& prefix, std::vector<uint32_t>* handles) {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	if (titleIndexed) {
+		titles.Prefix(prefix, bids, handles);
+		return;
+	}
+
+	std::string folded = TitleIndex::Fold(prefix);
+	std::vector<uint32_t> order;
+
+	handles->clear();
+	gather(this->root, &order);
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t bid = nodes[order[i]].bid;
+
+		if (TitleIndex::Fold(bids.Title(bid)).compare(0, folded.size(), folded) == 0) {
+			handles->push_back(bid);
+		}
+	}
+}
+
+/**
+* Find the bids whose titles contain some text, ignoring case. The handles
+* can be read through Bids() until the tree next changes.
+* @param text: The text to look for.
+* @param handles: Receives the handles, in handle order when the index is built and in id order otherwise.
+*/
+void BinarySearchTree::FindByTitleSubstring(const std::string& text, std::vector<uint32_t>* handles) {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	if (titleIndexed) {
+		titles.Substring(text, bids, handles);
+		return;
+	}
+
+	std::string folded = TitleIndex::Fold(text);
+	std::vector<uint32_t> order;
+
+	handles->clear();
+	gather(this->root, &order);
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t bid = nodes[order[i]].bid;
+
+		if (TitleIndex::Fold(bids.Title(bid)).find(folded) != std::string::npos) {
+			handles->push_back(bid);
+		}
+	}
+}
+
+/**
+* Build a hash index over the bid ids. Search and SearchBatch then look ids up
+* in it rather than descending the tree, while ordered walks and range queries
+* still use the tree. The index is kept up to date as the tree changes, until
+* it is dropped.
+*/
+void BinarySearchTree::BuildHashIndex() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	std::vector<uint32_t> order;
+	gather(this->root, &order);
+
+	hashIndex.Clear();
+	hashIndexed = true;
+
+	for (size_t i = 0; i < order.size(); i++) {
+		uint32_t bid = nodes[order[i]].bid;
+		hashIndex.Insert(bids.Key(bid), bid);
+	}
+}
+
+/**
+* Discard the hash index and free its memory.
+*/
+void BinarySearchTree::DropHashIndex() {
+	std::lock_guard<std::mutex> guard(versionLock);
+
+	hashIndex.Clear();
+	hashIndexed = false;
+}
+
+/**
+* Check whether the hash index is built.
+* @return True if Search uses the hash index.
+*/
+bool BinarySearchTree::HasHashIndex() {
+	return hashIndexed;
+}
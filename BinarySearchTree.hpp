@@ -1,31 +1,154 @@
 #pragma once
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
 #include "Node.hpp"
 #include "Bid.hpp"
+#include "BidStore.hpp"
+#include "WideIndex.hpp"
+#include "EytzingerIndex.hpp"
+#include "SecondaryIndex.hpp"
+#include "TimeIndex.hpp"
+#include "TitleIndex.hpp"
+#include "HashIndex.hpp"
+
+class TreeSnapshot;
+
+/**
+ * Tells what Insert or Upsert did with a bid.
+ */
+enum StoreResult {
+	BID_INSERTED, // stored as a new bid
+	BID_REPLACED, // replaced the bid already stored under its id
+	BID_REJECTED  // not stored, because BidStore::ParseKey can't key its id
+};
+
+/**
+ * Tests a bid, read from its store by handle, for removal by RemoveIf.
+ */
+typedef std::function<bool(const BidStore& bids, uint32_t handle)> BidPredicate;
 
 /**
  * Define a class containing data members and methods to
  * implement a binary search tree
+ *
+ * Nodes are also kept in heap order of a hash of their key (a treap), so the
+ * tree stays balanced whatever order the bids arrive in, and ranges can be
+ * split off and joined back in logarithmic time.
+ *
+ * One thread changes the tree. Other threads may read it at the same time
+ * through a TreeSnapshot, which sees the tree as it was when the snapshot was
+ * taken. While a snapshot is held, changes copy the nodes they touch instead
+ * of writing over them.
  */
 class BinarySearchTree {
 
+	friend class TreeSnapshot;
+
 private:
-	Node* root;
+	// A node or bid that a snapshot may still be reading, and the epoch it was retired in.
+	struct Retired {
+		uint32_t index;
+		uint32_t epoch;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> freeNodes;
+	BidStore bids;
+	WideIndex index;
+	EytzingerIndex frozenIndex;
+	bool frozen;
+	SecondaryIndex secondary;
+	bool secondaryIndexed;
+	TimeIndex closeDates;
+	TitleIndex titles;
+	bool titleIndexed;
+	HashIndex hashIndex;
+	bool hashIndexed;
+	uint32_t root;
+
+	uint32_t epoch;
+	std::map<uint32_t, int> pinned; // epoch -> number of snapshots taken in it
+	std::deque<Retired> retiredNodes;
+	std::deque<Retired> retiredBids;
+	std::mutex versionLock; // held while changing the tree and while taking or releasing a snapshot
+	std::shared_timed_mutex storageLock; // held shared by snapshot readers, exclusive while storage grows
 
-	void addNode(Node* node, Bid bid);
-	void inOrder(Node* node);
-	void inOrderJSON(Node* node, std::stringstream* buffer);
-	Node* removeNode(Node* node, std::string bidId);
+	void insert(uint32_t key, const Bid& bid);
+	uint32_t addNode(const Bid& bid);
+	void reserveBid(const Bid& bid);
+	uint32_t allocNode();
+	static uint32_t priority(uint32_t key);
+	void split(uint32_t node, uint32_t key, uint32_t* left, uint32_t* right);
+	uint32_t join(uint32_t left, uint32_t right);
+	int retireSubtree(uint32_t node);
+	uint32_t removeIf(uint32_t node, const BidPredicate& predicate, int* removed);
+	uint32_t own(uint32_t node);
+	static Aggregate none();
+	static void combine(Aggregate* total, const Aggregate& part);
+	Aggregate totalOf(uint32_t node);
+	void update(uint32_t node);
+	uint32_t relink(const std::vector<uint32_t>& path, const std::vector<bool>& rightSide, uint32_t child);
+	void retireNode(uint32_t node);
+	void retireBid(uint32_t bid);
+	void indexBid(uint32_t bid);
+	void indexOptional(uint32_t bid);
+	std::vector<Bid> scan(const BidPredicate& predicate);
+	void reclaim();
+	void releaseSnapshot(uint32_t snapshotEpoch);
 	std::string fixQuotes(std::string source);
-	int size(Node* node);
-	void deleteAll(Node* node);
+	uint32_t adopt(const BinarySearchTree* other);
+	uint32_t edgeKey(uint32_t node, bool rightmost);
+	void gather(uint32_t node, std::vector<uint32_t>* order);
+	uint32_t build(const std::vector<uint32_t>& order);
+	int size(uint32_t node);
+	void collect(uint32_t node, std::vector<uint32_t>* keys, std::vector<uint32_t>* handles);
 
 public:
 	BinarySearchTree();
 	virtual ~BinarySearchTree();
 	void InOrder();
 	void InOrderJSON();
-	void Insert(Bid bid);
+	StoreResult Insert(Bid bid);
+	StoreResult Upsert(Bid bid);
 	void Remove(std::string bidId);
+	int RemoveRange(std::string loBidId, std::string hiBidId);
+	int RemoveIf(const BidPredicate& predicate);
+	void Merge(const BinarySearchTree* other);
 	Bid Search(std::string bidId);
+	void SearchBatch(const std::vector<std::string>& bidIds, std::vector<uint32_t>* handles);
+	std::shared_ptr<TreeSnapshot> Snapshot();
+	const BidStore& Bids();
+	std::vector<std::string> BidIds();
 	int Size();
-};
\ No newline at end of file
+	void BuildIndex();
+	void Freeze();
+	void Thaw();
+	bool IsFrozen();
+	void BuildSecondaryIndexes();
+	void DropSecondaryIndexes();
+	bool HasSecondaryIndexes();
+	std::vector<Bid> FindByFund(std::string fund);
+	std::vector<Bid> FindByAmount(double lo, double hi);
+	std::vector<Bid> ClosedBetween(std::string fromDate, std::string toDate);
+	std::vector<Rollup> DailyTotals(std::string fromDate, std::string toDate);
+	std::vector<Rollup> WeeklyTotals(std::string fromDate, std::string toDate);
+	void BuildTitleIndex();
+	void DropTitleIndex();
+	bool HasTitleIndex();
+	void FindByTitlePrefix(const std::string& prefix, std::vector<uint32_t>* handles);
+	void FindByTitleSubstring(const std::string& text, std::vector<uint32_t>* handles);
+	void BuildHashIndex();
+	void DropHashIndex();
+	bool HasHashIndex();
+	double TotalAmount();
+	Aggregate AmountsInRange(std::string loBidId, std::string hiBidId);
+	double SumRange(std::string loBidId, std::string hiBidId);
+	double MaxInRange(std::string loBidId, std::string hiBidId);
+	std::vector<Bid> TopByAmount(size_t count);
+	size_t MemoryUsage();
+};
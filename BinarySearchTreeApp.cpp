@@ -7,9 +7,11 @@
 //============================================================================
 
 #include <iostream>
+#include <chrono>
 #include <time.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <sstream>
 #include "CSVparser/CSVparser.hpp"
 #include "Node.hpp"
 #include "Bid.hpp"
@@ -19,6 +21,30 @@ using namespace std;
 
 int main(int argc, char* argv[]) {
 
+	// Take out the options that answer requests in place of the menu:
+	// --serve reads them from stdin, --socket <path> from a Unix-domain socket.
+	bool serve = false;
+	string socketPath = "";
+	vector<char*> args(1, argv[0]);
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+
+		if (arg == "--serve") {
+			serve = true;
+		}
+		else if (arg == "--socket" && i + 1 < argc) {
+			serve = true;
+			socketPath = argv[++i];
+		}
+		else {
+			args.push_back(argv[i]);
+		}
+	}
+
+	argc = (int)args.size();
+	argv = args.data();
+
 	// process command line arguments
 	string csvPath = "";
 	string bidKey = "";
@@ -40,11 +66,37 @@ int main(int argc, char* argv[]) {
 	// Define a timer variable
 	clock_t ticks;
 
+	// Wall-clock start of a load spread over several threads, which clock() would count once per thread
+	chrono::steady_clock::time_point loadStarted;
+
 	// Define a binary search tree to hold all bids
 	BinarySearchTree* bst;
 	bst = new BinarySearchTree();
 
+	if (serve) {
+		return BST::serveBids(bst, csvPath, socketPath);
+	}
+
+	// Index titles as the bids load, rather than in a separate pass afterwards
+	bst->BuildTitleIndex();
+
 	Bid bid;
+	vector<Bid> found;
+	string fund;
+	double loAmount;
+	double hiAmount;
+	string fromDate;
+	string toDate;
+	vector<Rollup> rollups;
+	string titleText;
+	vector<uint32_t> handles;
+	string pathList;
+	istringstream paths;
+	string path;
+	vector<string> csvPaths;
+
+	// Where the last load stopped reading, so loading again only reads appended rows
+	streamoff loadedOffset = 0;
 
 	int choice = 0;
 	while (choice != 9) {
@@ -54,6 +106,18 @@ int main(int argc, char* argv[]) {
 		cout << "  3. Find Bid" << endl;
 		cout << "  4. Remove Bid" << endl;
 		cout << "  5. Export to JSON" << endl;
+		cout << "  6. Build Search Index" << endl;
+		cout << "  7. Freeze Tree" << endl;
+		cout << "  8. Thaw Tree" << endl;
+		cout << " 10. Benchmark Lookups" << endl;
+		cout << " 11. Find Bids by Fund" << endl;
+		cout << " 12. Find Bids by Amount" << endl;
+		cout << " 13. Find Bids by Close Date" << endl;
+		cout << " 14. Daily and Weekly Totals" << endl;
+		cout << " 15. Find Bids by Title Prefix" << endl;
+		cout << " 16. Find Bids by Title Text" << endl;
+		cout << " 17. Build Hash Index" << endl;
+		cout << " 18. Load Bids from Several Files" << endl;
 		cout << "  9. Exit" << endl;
 		cout << "Enter choice: ";
 		cin >> choice;
@@ -66,11 +130,17 @@ int main(int argc, char* argv[]) {
 			ticks = clock();
 
 			// Complete the method call to load the bids
-			BST::loadBids(csvPath, bst);
+			try {
+				loadedOffset = BST::loadBids(csvPath, bst, loadedOffset);
+			}
+			catch (csv::Error& e) {
+				cerr << e.what() << endl;
+			}
 
 			ticks = clock() - ticks; // current clock ticks minus starting clock ticks
 
 			cout << bst->Size() << " bids read" << endl;
+			cout << bst->MemoryUsage() << " bytes used" << endl;
 
 			// Calculate elapsed time and display result
 			cout << "time: " << ticks << " clock ticks" << endl;
@@ -107,6 +177,129 @@ int main(int argc, char* argv[]) {
 		case 5:
 			bst->InOrderJSON();
 			break;
+
+		case 6:
+			bst->BuildIndex();
+			cout << "Search index built (" << WideIndex::Implementation() << ")" << endl;
+			break;
+
+		case 7:
+			bst->Freeze();
+			cout << "Tree frozen." << endl;
+			break;
+
+		case 8:
+			bst->Thaw();
+			cout << "Tree thawed." << endl;
+			break;
+
+		case 10:
+			BST::benchmarkLookups(bst, 1000000);
+			break;
+
+		case 11:
+			cout << "Fund: ";
+			getline(cin >> ws, fund);
+
+			if (!bst->HasSecondaryIndexes()) {
+				bst->BuildSecondaryIndexes();
+			}
+
+			found = bst->FindByFund(fund);
+			for (size_t i = 0; i < found.size(); i++) {
+				BST::displayBid(found[i]);
+			}
+			cout << found.size() << " bids found" << endl;
+			break;
+
+		case 12:
+			cout << "Lowest and highest amount: ";
+			cin >> loAmount >> hiAmount;
+
+			if (!bst->HasSecondaryIndexes()) {
+				bst->BuildSecondaryIndexes();
+			}
+
+			found = bst->FindByAmount(loAmount, hiAmount);
+			for (size_t i = 0; i < found.size(); i++) {
+				BST::displayBid(found[i]);
+			}
+			cout << found.size() << " bids found" << endl;
+			break;
+
+		case 13:
+			cout << "First and last close date (m/d/yy): ";
+			cin >> fromDate >> toDate;
+
+			found = bst->ClosedBetween(fromDate, toDate);
+			for (size_t i = 0; i < found.size(); i++) {
+				BST::displayBid(found[i]);
+			}
+			cout << found.size() << " bids found" << endl;
+			break;
+
+		case 14:
+			cout << "First and last close date (m/d/yy): ";
+			cin >> fromDate >> toDate;
+
+			rollups = bst->DailyTotals(fromDate, toDate);
+			for (size_t i = 0; i < rollups.size(); i++) {
+				cout << "Day of " << BST::formatDate(rollups[i].date) << ": " << rollups[i].count << " bids | " << rollups[i].amount << endl;
+			}
+
+			rollups = bst->WeeklyTotals(fromDate, toDate);
+			for (size_t i = 0; i < rollups.size(); i++) {
+				cout << "Week of " << BST::formatDate(rollups[i].date) << ": " << rollups[i].count << " bids | " << rollups[i].amount << endl;
+			}
+			break;
+
+		case 15:
+		case 16:
+			cout << "Title text: ";
+			getline(cin >> ws, titleText);
+
+			if (choice == 15) {
+				bst->FindByTitlePrefix(titleText, &handles);
+			}
+			else {
+				bst->FindByTitleSubstring(titleText, &handles);
+			}
+
+			for (size_t i = 0; i < handles.size(); i++) {
+				BST::displayBid(bst->Bids().Get(handles[i]));
+			}
+			cout << handles.size() << " bids found" << endl;
+			break;
+
+		case 17:
+			bst->BuildHashIndex();
+			cout << "Hash index built (" << HashIndex::Implementation() << ")" << endl;
+			break;
+
+		case 18:
+			cout << "CSV files, separated by spaces: ";
+			getline(cin >> ws, pathList);
+
+			paths.clear();
+			paths.str(pathList);
+			csvPaths.clear();
+			while (paths >> path) {
+				csvPaths.push_back(path);
+			}
+
+			loadStarted = chrono::steady_clock::now();
+
+			// Each file loads on its own thread; where files share an id, the later file wins.
+			try {
+				BST::loadBidFiles(csvPaths, bst);
+			}
+			catch (csv::Error& e) {
+				cerr << e.what() << endl;
+			}
+
+			cout << bst->Size() << " bids read" << endl;
+			cout << "time: " << chrono::duration<double>(chrono::steady_clock::now() - loadStarted).count() << " seconds" << endl;
+			break;
 		
 		default:
 			cout << "Invalid option." << std::endl;
@@ -0,0 +1,95 @@
+#include "EytzingerIndex.hpp"
+#include "Node.hpp"
+#include "Prefetch.hpp"
+
+/**
+ * Default constructor
+ */
+EytzingerIndex::EytzingerIndex() {
+	count = 0;
+}
+
+/**
+ * Copy sorted keys into their Eytzinger slots with an in-order walk of the implicit tree.
+ * @param sortedKeys: The keys in ascending order.
+ * @param sortedValues: The value stored with each key.
+ * @param next: The position of the next sorted key to place.
+ * @param slot: The slot to visit.
+ * @return The position of the next sorted key after this subtree is filled.
+ */
+size_t EytzingerIndex::fill(const std::vector<uint32_t>& sortedKeys, const std::vector<uint32_t>& sortedValues, size_t next, size_t slot) {
+	if (slot > count) {
+		return next;
+	}
+
+	next = fill(sortedKeys, sortedValues, next, 2 * slot);
+	keys[slot] = sortedKeys[next];
+	values[slot] = sortedValues[next];
+	++next;
+	next = fill(sortedKeys, sortedValues, next, 2 * slot + 1);
+
+	return next;
+}
+
+/**
+ * Build the index from keys in ascending order.
+ * @param keys: The sorted keys.
+ * @param values: The value stored with each key.
+ */
+void EytzingerIndex::Build(const std::vector<uint32_t>& keys, const std::vector<uint32_t>& values) {
+	count = keys.size();
+	this->keys.assign(count + 1, 0);
+	this->values.assign(count + 1, NIL_INDEX);
+
+	fill(keys, values, 0, 1);
+}
+
+/**
+ * Remove every key from the index and release its memory.
+ */
+void EytzingerIndex::Clear() {
+	std::vector<uint32_t>().swap(keys);
+	std::vector<uint32_t>().swap(values);
+	count = 0;
+}
+
+/**
+ * Find a key in the index.
+ * @param key: The key to find.
+ * @return The value stored with the key, or NIL_INDEX if it is not present.
+ */
+uint32_t EytzingerIndex::Find(uint32_t key) const {
+	const uint32_t* slots = keys.data();
+	size_t slot = 1;
+
+	while (slot <= count) {
+		// The sixteen descendants four levels down share one cache line; request it now.
+		if (16 * slot <= count) {
+			BST::prefetch(slots + 16 * slot);
+		}
+
+		// Step left or right without a branch.
+		slot = 2 * slot + (slots[slot] < key ? 1 : 0);
+	}
+
+	// The lower bound is the last slot where the search stepped left. Strip the
+	// trailing right steps, then that left step, to get back to it.
+	while (slot & 1) {
+		slot >>= 1;
+	}
+	slot >>= 1;
+
+	if (slot != 0 && slots[slot] == key) {
+		return values[slot];
+	}
+
+	return NIL_INDEX;
+}
+
+/**
+ * Estimate the heap memory held by the index.
+ * @return The number of bytes reserved by the keys and values.
+ */
+size_t EytzingerIndex::MemoryUsage() const {
+	return (keys.capacity() + values.capacity()) * sizeof(uint32_t);
+}
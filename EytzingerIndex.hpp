@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Define a read-only index over sorted integer keys laid out in Eytzinger
+ * (breadth-first) order. The children of slot k are slots 2k and 2k+1, so
+ * the search needs no pointers, has no unpredictable branches and can
+ * prefetch the descendants several levels ahead.
+ */
+class EytzingerIndex {
+
+private:
+	std::vector<uint32_t> keys; // slot 0 is unused so the root is slot 1
+	std::vector<uint32_t> values;
+	size_t count;
+
+	size_t fill(const std::vector<uint32_t>& sortedKeys, const std::vector<uint32_t>& sortedValues, size_t next, size_t slot);
+
+public:
+	EytzingerIndex();
+	void Build(const std::vector<uint32_t>& keys, const std::vector<uint32_t>& values);
+	void Clear();
+	bool Empty() const { return count == 0; }
+	uint32_t Find(uint32_t key) const;
+	size_t MemoryUsage() const;
+};
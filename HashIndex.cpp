@@ -0,0 +1,313 @@
+#include "HashIndex.hpp"
+#include "Node.hpp"
+
+// Define BST_NO_SIMD to build the scalar group search on x86 too.
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)) && !defined(BST_NO_SIMD)
+#define HASH_INDEX_X86 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+	const uint8_t EMPTY = 0x80;
+	const uint8_t DELETED = 0xFE;
+
+	/**
+	 * Get the position of the lowest set bit of a non-zero mask.
+	 */
+	unsigned lowestBit(unsigned mask) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (unsigned)index;
+#else
+		return (unsigned)__builtin_ctz(mask);
+#endif
+	}
+}
+
+/**
+ * Default constructor
+ */
+HashIndex::HashIndex() {
+	groupMask = 0;
+	count = 0;
+	used = 0;
+}
+
+/**
+ * Mix a key into a 64-bit hash. The top seven bits become the slot's metadata
+ * and the bits below them pick the group.
+ * @param key: The key to hash.
+ * @return The hash.
+ */
+uint64_t HashIndex::hash(uint32_t key) {
+	uint64_t h = (uint64_t)key * 0x9E3779B97F4A7C15ull;
+
+	return h ^ (h >> 29);
+}
+
+/**
+ * Find the slots of a group whose metadata equals a tag.
+ * @param group: The group to search.
+ * @param tag: The metadata byte to look for.
+ * @return A mask with bit i set if slot i matches.
+ */
+unsigned HashIndex::match(size_t group, uint8_t tag) const {
+	const uint8_t* bytes = control.data() + group * GROUP_SLOTS;
+
+#ifdef HASH_INDEX_X86
+	__m128i meta = _mm_loadu_si128((const __m128i*)bytes);
+
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(meta, _mm_set1_epi8((char)tag)));
+#else
+	unsigned mask = 0;
+
+	for (size_t i = 0; i < GROUP_SLOTS; i++) {
+		mask |= (bytes[i] == tag ? 1u : 0u) << i;
+	}
+
+	return mask;
+#endif
+}
+
+/**
+ * Find the slots of a group that are empty or deleted.
+ * @param group: The group to search.
+ * @return A mask with bit i set if slot i can take a new key.
+ */
+unsigned HashIndex::matchFree(size_t group) const {
+	const uint8_t* bytes = control.data() + group * GROUP_SLOTS;
+
+#ifdef HASH_INDEX_X86
+	// Only the free markers have their top bit set, and movemask reads exactly that bit.
+	return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)bytes));
+#else
+	unsigned mask = 0;
+
+	for (size_t i = 0; i < GROUP_SLOTS; i++) {
+		mask |= (unsigned)(bytes[i] >> 7) << i;
+	}
+
+	return mask;
+#endif
+}
+
+/**
+ * Find the empty slots of a group. A lookup can stop at a group with one,
+ * since an insert would have used it before probing further.
+ * @param group: The group to search.
+ * @return A mask with bit i set if slot i is empty.
+ */
+unsigned HashIndex::matchEmpty(size_t group) const {
+	return match(group, EMPTY);
+}
+
+/**
+ * Add a key and value. Adding a pair that is already present does nothing,
+ * but a key may be added more than once with different values.
+ * @param key: The key.
+ * @param value: The value.
+ */
+void HashIndex::Insert(uint32_t key, uint32_t value) {
+	// Keep at least one slot in eight empty so every probe sequence ends.
+	if (control.empty() || (used + 1) * 8 > control.size() * 7) {
+		size_t groups = (groupMask + 1);
+
+		// Clean out deleted slots in place if they are what fills the table.
+		rehash(control.empty() ? 1 : (count * 2 < control.size() ? groups : groups * 2));
+	}
+
+	uint64_t h = hash(key);
+	uint8_t tag = (uint8_t)(h >> 57);
+	size_t group = (size_t)(h >> 20) & groupMask;
+	size_t target = (size_t)-1;
+
+	for (size_t step = 1;; step++) {
+		unsigned found = match(group, tag);
+
+		while (found != 0) {
+			size_t slot = group * GROUP_SLOTS + lowestBit(found);
+
+			if (keys[slot] == key && values[slot] == value) {
+				return;
+			}
+			found &= found - 1;
+		}
+
+		if (target == (size_t)-1) {
+			unsigned free = matchFree(group);
+
+			if (free != 0) {
+				target = group * GROUP_SLOTS + lowestBit(free);
+			}
+		}
+
+		if (matchEmpty(group) != 0) {
+			break;
+		}
+
+		group = (group + step) & groupMask;
+	}
+
+	if (control[target] == EMPTY) {
+		++used;
+	}
+
+	control[target] = tag;
+	keys[target] = key;
+	values[target] = value;
+	++count;
+}
+
+/**
+ * Remove a key and value.
+ * @param key: The key.
+ * @param value: The value stored with it.
+ * @return True if the pair was found.
+ */
+bool HashIndex::Erase(uint32_t key, uint32_t value) {
+	if (count == 0) {
+		return false;
+	}
+
+	uint64_t h = hash(key);
+	uint8_t tag = (uint8_t)(h >> 57);
+	size_t group = (size_t)(h >> 20) & groupMask;
+
+	for (size_t step = 1;; step++) {
+		unsigned found = match(group, tag);
+
+		while (found != 0) {
+			size_t slot = group * GROUP_SLOTS + lowestBit(found);
+
+			if (keys[slot] == key && values[slot] == value) {
+				// A group with an empty slot never sent a probe onward, so the slot can become empty again.
+				bool empty = matchEmpty(group) != 0;
+
+				control[slot] = empty ? EMPTY : DELETED;
+				if (empty) {
+					--used;
+				}
+				--count;
+				return true;
+			}
+			found &= found - 1;
+		}
+
+		if (matchEmpty(group) != 0) {
+			return false;
+		}
+
+		group = (group + step) & groupMask;
+	}
+}
+
+/**
+ * Look up a key.
+ * @param key: The key to look for.
+ * @return A value stored with the key, or NIL_INDEX if the key is absent.
+ */
+uint32_t HashIndex::Find(uint32_t key) const {
+	if (count == 0) {
+		return NIL_INDEX;
+	}
+
+	uint64_t h = hash(key);
+	uint8_t tag = (uint8_t)(h >> 57);
+	size_t group = (size_t)(h >> 20) & groupMask;
+
+	for (size_t step = 1;; step++) {
+		unsigned found = match(group, tag);
+
+		while (found != 0) {
+			size_t slot = group * GROUP_SLOTS + lowestBit(found);
+
+			if (keys[slot] == key) {
+				return values[slot];
+			}
+			found &= found - 1;
+		}
+
+		if (matchEmpty(group) != 0) {
+			return NIL_INDEX;
+		}
+
+		group = (group + step) & groupMask;
+	}
+}
+
+/**
+ * Get the metadata of the first group a key's lookup reads, for prefetching.
+ * @param key: The key about to be looked up.
+ * @return The address of the group's metadata, or null if the index is empty.
+ */
+const void* HashIndex::GroupAddress(uint32_t key) const {
+	if (control.empty()) {
+		return nullptr;
+	}
+
+	return control.data() + ((size_t)(hash(key) >> 20) & groupMask) * GROUP_SLOTS;
+}
+
+/**
+ * Move every live key into a table of a new size, dropping deleted slots.
+ * @param groups: The number of groups in the new table, a power of two.
+ */
+void HashIndex::rehash(size_t groups) {
+	std::vector<uint8_t> oldControl(groups * GROUP_SLOTS, EMPTY);
+	std::vector<uint32_t> oldKeys(groups * GROUP_SLOTS);
+	std::vector<uint32_t> oldValues(groups * GROUP_SLOTS);
+
+	// Swap the new table in; the old one is left in the local vectors to be reinserted.
+	oldControl.swap(control);
+	oldKeys.swap(keys);
+	oldValues.swap(values);
+
+	groupMask = groups - 1;
+	count = 0;
+	used = 0;
+
+	for (size_t slot = 0; slot < oldControl.size(); slot++) {
+		if ((oldControl[slot] & 0x80) == 0) {
+			Insert(oldKeys[slot], oldValues[slot]);
+		}
+	}
+}
+
+/**
+ * Remove every key and free the table.
+ */
+void HashIndex::Clear() {
+	std::vector<uint8_t>().swap(control);
+	std::vector<uint32_t>().swap(keys);
+	std::vector<uint32_t>().swap(values);
+	groupMask = 0;
+	count = 0;
+	used = 0;
+}
+
+/**
+ * Estimate the heap memory held by the index.
+ * @return The number of bytes reserved by the metadata, keys and values.
+ */
+size_t HashIndex::MemoryUsage() const {
+	return control.capacity() * sizeof(uint8_t)
+		+ keys.capacity() * sizeof(uint32_t)
+		+ values.capacity() * sizeof(uint32_t);
+}
+
+/**
+ * Name the group search compiled for this processor.
+ * @return "sse2" or "scalar".
+ */
+const char* HashIndex::Implementation() {
+#ifdef HASH_INDEX_X86
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
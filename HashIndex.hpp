@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Define an open-addressing hash index from integer keys to values, laid out
+ * like a Swiss table. Slots come in groups of sixteen, each with a byte of
+ * metadata holding seven bits of the key's hash, and a lookup compares all
+ * sixteen bytes of a group at once with SSE2, falling back to a scalar loop
+ * on other processors. A hit usually costs one metadata line and one key line.
+ * Unlike WideIndex, the hash index is updated in place as keys come and go.
+ */
+class HashIndex {
+
+public:
+	static const size_t GROUP_SLOTS = 16;
+
+private:
+	std::vector<uint8_t> control; // one byte per slot: EMPTY, DELETED, or seven bits of hash
+	std::vector<uint32_t> keys;
+	std::vector<uint32_t> values;
+	size_t groupMask;
+	size_t count; // live slots
+	size_t used; // live and deleted slots
+
+	unsigned match(size_t group, uint8_t tag) const;
+	unsigned matchFree(size_t group) const;
+	unsigned matchEmpty(size_t group) const;
+	void rehash(size_t groups);
+
+	static uint64_t hash(uint32_t key);
+
+public:
+	HashIndex();
+	void Insert(uint32_t key, uint32_t value);
+	bool Erase(uint32_t key, uint32_t value);
+	uint32_t Find(uint32_t key) const;
+	const void* GroupAddress(uint32_t key) const;
+	void Clear();
+	size_t Size() const { return count; }
+	size_t MemoryUsage() const;
+
+	static const char* Implementation();
+};
@@ -0,0 +1,339 @@
+/**
+ * Regression checks for the lookup indexes, each compared with a standard
+ * container or a brute-force search over the same data. Built as its own
+ * program next to the app.
+ *
+ * WideIndex and EytzingerIndex are checked against std::set, HashIndex
+ * against a std::multiset of key and value pairs, and TitleIndex against
+ * matching every title by hand. Which block and group searches ran is
+ * printed first; build with -DBST_NO_AVX2 or -DBST_NO_SIMD as well to check
+ * the SSE2 and scalar ones.
+ *
+ * Returns 0 if every check passed.
+ */
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BidStore.hpp"
+#include "EytzingerIndex.hpp"
+#include "HashIndex.hpp"
+#include "Node.hpp"
+#include "TitleIndex.hpp"
+#include "WideIndex.hpp"
+
+namespace
+{
+	int failures = 0;
+
+	/**
+	 * Record a failed check
+	 *
+	 * @param passed: The result of the check.
+	 * @param what: Describes the check, printed if it failed.
+	 */
+	void expect(bool passed, const std::string& what)
+	{
+		if (!passed) {
+			if (failures++ < 20) {
+				std::cerr << "FAILED: " << what << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * Build both read-only indexes over random keys and look up every key,
+	 * its neighbours and random keys in each
+	 *
+	 * @param rng: The random numbers to draw from.
+	 * @param count: The number of keys.
+	 * @param span: Keys are drawn below this, or from every 32-bit value if it is 0.
+	 */
+	void sortedKeys(std::mt19937& rng, size_t count, uint32_t span)
+	{
+		std::set<uint32_t> expected;
+
+		// The extremes and the sign bit, which the wide index flips, are the likeliest to go wrong.
+		if (span == 0 && count >= 4) {
+			expected.insert(0);
+			expected.insert(0x7FFFFFFFu);
+			expected.insert(0x80000000u);
+			expected.insert(0xFFFFFFFFu);
+		}
+		while (expected.size() < count) {
+			expected.insert(span ? rng() % span : (uint32_t)rng());
+		}
+
+		std::vector<uint32_t> keys(expected.begin(), expected.end());
+		std::vector<uint32_t> values;
+
+		for (size_t i = 0; i < keys.size(); i++) {
+			values.push_back((uint32_t)i * 7 + 1);
+		}
+
+		WideIndex wide;
+		EytzingerIndex eytzinger;
+
+		wide.Build(keys, values);
+		eytzinger.Build(keys, values);
+
+		std::vector<uint32_t> probes;
+
+		for (size_t i = 0; i < keys.size(); i++) {
+			probes.push_back(keys[i]);
+			probes.push_back(keys[i] - 1);
+			probes.push_back(keys[i] + 1);
+		}
+		for (size_t i = 0; i < count + 100; i++) {
+			probes.push_back(span ? rng() % (span + 10) : (uint32_t)rng());
+		}
+
+		bool wideMatches = true;
+		bool eytzingerMatches = true;
+
+		for (size_t i = 0; i < probes.size(); i++) {
+			std::vector<uint32_t>::iterator it = std::lower_bound(keys.begin(), keys.end(), probes[i]);
+			uint32_t value = (it != keys.end() && *it == probes[i]) ? values[it - keys.begin()] : NIL_INDEX;
+
+			wideMatches = wideMatches && wide.Find(probes[i]) == value;
+			eytzingerMatches = eytzingerMatches && eytzinger.Find(probes[i]) == value;
+		}
+
+		std::string size = " with " + std::to_string(count) + " keys";
+
+		expect(wideMatches, "WideIndex finds what std::set holds" + size);
+		expect(eytzingerMatches, "EytzingerIndex finds what std::set holds" + size);
+
+		wide.Clear();
+		eytzinger.Clear();
+		expect(wide.Empty() && wide.Find(probes[0]) == NIL_INDEX, "A cleared WideIndex finds nothing");
+		expect(eytzinger.Empty() && eytzinger.Find(probes[0]) == NIL_INDEX, "A cleared EytzingerIndex finds nothing");
+	}
+
+	/**
+	 * Apply random inserts and erases to a hash index and a multiset of pairs
+	 *
+	 * @param seed: Seeds the random changes, so a failure can be repeated.
+	 */
+	void hashChanges(unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		HashIndex index;
+		std::multiset<std::pair<uint32_t, uint32_t> > expected;
+
+		// A small key range fills groups and leaves deleted slots; a large one makes the table grow.
+		uint32_t span = (seed % 2) ? 1 + rng() % 3000 : 0;
+
+		for (int i = 0; i < 60000; i++) {
+			uint32_t key = span ? rng() % span : (uint32_t)rng();
+			uint32_t value = rng() % 4;
+
+			switch (rng() % 3) {
+			case 0:
+				index.Insert(key, value);
+				if (expected.count(std::make_pair(key, value)) == 0) {
+					expected.insert(std::make_pair(key, value));
+				}
+				break;
+
+			case 1: {
+				std::multiset<std::pair<uint32_t, uint32_t> >::iterator it = expected.find(std::make_pair(key, value));
+
+				expect(index.Erase(key, value) == (it != expected.end()), "HashIndex erases only pairs it holds");
+				if (it != expected.end()) {
+					expected.erase(it);
+				}
+				break;
+			}
+
+			default: {
+				uint32_t found = index.Find(key);
+				std::multiset<std::pair<uint32_t, uint32_t> >::iterator it = expected.lower_bound(std::make_pair(key, 0u));
+
+				if (it != expected.end() && it->first == key) {
+					expect(found != NIL_INDEX && expected.count(std::make_pair(key, found)) == 1, "HashIndex finds a value stored with the key");
+				}
+				else {
+					expect(found == NIL_INDEX, "HashIndex finds nothing for an absent key");
+				}
+				break;
+			}
+			}
+
+			expect(index.Size() == expected.size(), "HashIndex counts the pairs it holds");
+
+			if (i == 40000) {
+				index.Clear();
+				expected.clear();
+			}
+		}
+	}
+
+	/**
+	 * Make a random title from letters around the ASCII case boundaries and a
+	 * UTF-8 letter in both cases, which must not fold into each other.
+	 */
+	std::string randomTitle(std::mt19937& rng)
+	{
+		static const char* const PIECES[] = { "a", "A", "b", "B", "z", "Z", "@", "[", " ", "\xC3\xA9", "\xC3\x89" };
+		std::string title;
+		size_t length = rng() % 7;
+
+		for (size_t i = 0; i < length; i++) {
+			title += PIECES[rng() % (sizeof(PIECES) / sizeof(PIECES[0]))];
+		}
+
+		return title;
+	}
+
+	/**
+	 * Lower-case the ASCII letters of a string, written out apart from
+	 * TitleIndex::Fold so a mistake there can't hide in the expected results.
+	 */
+	std::string lowerAscii(std::string text)
+	{
+		for (size_t i = 0; i < text.size(); i++) {
+			if (text[i] >= 'A' && text[i] <= 'Z') {
+				text[i] = (char)(text[i] - 'A' + 'a');
+			}
+		}
+
+		return text;
+	}
+
+	/**
+	 * Order handles by folded title, then by handle, the order Prefix gives
+	 */
+	struct ByFoldedTitle {
+		const BidStore* bids;
+
+		bool operator()(uint32_t first, uint32_t second) const
+		{
+			std::string a = lowerAscii(bids->Title(first));
+			std::string b = lowerAscii(bids->Title(second));
+
+			return (a != b) ? a < b : first < second;
+		}
+	};
+
+	/**
+	 * Apply random adds, replacements and removes to a title index, then
+	 * compare its lookups with matching every live title by hand
+	 *
+	 * @param seed: Seeds the random changes, so a failure can be repeated.
+	 */
+	void titleChanges(unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		BidStore bids;
+		TitleIndex index;
+		std::set<uint32_t> live;
+
+		for (int i = 0; i < 3000; i++) {
+			Bid bid;
+
+			bid.bidId = std::to_string(i);
+			bid.title = randomTitle(rng);
+			bid.fund = "f";
+
+			switch (rng() % 6) {
+			case 0:
+			case 1: {
+				uint32_t handle = bids.Add(bid);
+
+				index.Add(handle, bids);
+				live.insert(handle);
+				break;
+			}
+
+			case 2:
+				// Overwrite the title first, as an in-place Upsert does.
+				if (!live.empty()) {
+					uint32_t handle = *std::next(live.begin(), rng() % live.size());
+
+					bids.Set(handle, bid);
+					index.Add(handle, bids);
+				}
+				break;
+
+			case 3:
+				// Release the slot too, so a later add reuses the handle.
+				if (!live.empty()) {
+					uint32_t handle = *std::next(live.begin(), rng() % live.size());
+
+					index.Remove(handle);
+					bids.Release(handle);
+					live.erase(handle);
+				}
+				break;
+
+			default: {
+				std::string text = randomTitle(rng).substr(0, 1 + rng() % 4);
+				std::string folded = lowerAscii(text);
+				std::vector<uint32_t> prefixed;
+				std::vector<uint32_t> containing;
+				std::vector<uint32_t> found;
+
+				for (std::set<uint32_t>::iterator it = live.begin(); it != live.end(); ++it) {
+					std::string title = lowerAscii(bids.Title(*it));
+
+					if (title.compare(0, folded.size(), folded) == 0) {
+						prefixed.push_back(*it);
+					}
+					if (title.find(folded) != std::string::npos) {
+						containing.push_back(*it);
+					}
+				}
+
+				ByFoldedTitle order = { &bids };
+				std::sort(prefixed.begin(), prefixed.end(), order);
+
+				index.Prefix(text, bids, &found);
+				expect(found == prefixed, "TitleIndex::Prefix matches a scan, in folded-title order");
+
+				index.Substring(text, bids, &found);
+				expect(found == containing, "TitleIndex::Substring matches a scan, in handle order");
+				break;
+			}
+			}
+		}
+
+		index.Clear();
+
+		std::vector<uint32_t> found;
+		index.Prefix("", bids, &found);
+		expect(found.empty(), "A cleared TitleIndex finds nothing");
+	}
+}
+
+int main()
+{
+	std::cout << "WideIndex: " << WideIndex::Implementation() << ", HashIndex: " << HashIndex::Implementation() << std::endl;
+
+	std::mt19937 rng(7);
+	const size_t SIZES[] = { 0, 1, 2, 15, 16, 17, 31, 32, 33, 255, 256, 257, 4095, 4096, 4097, 20000 };
+
+	for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); i++) {
+		sortedKeys(rng, SIZES[i], 0);
+		sortedKeys(rng, SIZES[i], (uint32_t)SIZES[i] * 3 + 1);
+	}
+
+	for (unsigned seed = 1; seed <= 10; seed++) {
+		hashChanges(seed);
+	}
+
+	for (unsigned seed = 1; seed <= 20; seed++) {
+		titleChanges(seed);
+	}
+
+	if (failures > 0) {
+		std::cout << failures << " checks failed." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All index checks passed." << std::endl;
+	return 0;
+}
@@ -0,0 +1,290 @@
+#include "LoadPipeline.hpp"
+#include "StaticMethods.hpp"
+#include "CSVparser/CSVparser.hpp"
+#include <sstream>
+#include <thread>
+
+namespace {
+	const size_t BATCH_SIZE = 256;
+	const size_t QUEUE_BATCHES = 64;
+}
+
+/**
+ * Constructor
+ * @param csvPath: The path to the CSV file to load.
+ * @param offset: The byte offset to resume from, as returned by an earlier Run, or 0 to read the whole file.
+ */
+LoadPipeline::LoadPipeline(const std::string& csvPath, std::streamoff offset)
+	: csvPath(csvPath), columns(0), startOffset(offset), headerEnd(0), endOffset(offset),
+	lines(QUEUE_BATCHES), rows(QUEUE_BATCHES), bids(QUEUE_BATCHES), rejected(0), failed(false) {
+}
+
+namespace {
+	/**
+	 * Read one line, without its line ending.
+	 * @param file: The file to read from.
+	 * @param line: Receives the line.
+	 * @param consumed: Receives the number of bytes read, including the line ending.
+	 * @param terminated: Receives false if the file ended before a newline.
+	 * @return False at the end of the file.
+	 */
+	bool readLine(std::ifstream& file, std::string* line, std::streamoff* consumed, bool* terminated) {
+		if (!std::getline(file, *line)) {
+			return false;
+		}
+
+		*terminated = !file.eof();
+		*consumed = (std::streamoff)line->size() + (*terminated ? 1 : 0);
+
+		if (!line->empty() && (*line)[line->size() - 1] == '\r') {
+			line->erase(line->size() - 1);
+		}
+
+		return true;
+	}
+}
+
+/**
+ * Split one CSV line into fields. Commas inside double quotes do not split,
+ * and the quotes are kept, matching csv::Parser.
+ * @param line: The line to split.
+ * @return The fields of the line.
+ */
+std::vector<std::string> LoadPipeline::SplitRow(const std::string& line) {
+	std::vector<std::string> fields;
+	bool quoted = false;
+	size_t tokenStart = 0;
+
+	for (size_t i = 0; i < line.length(); i++) {
+		if (line[i] == '"') {
+			quoted = !quoted;
+		}
+		else if (line[i] == ',' && !quoted) {
+			fields.push_back(line.substr(tokenStart, i - tokenStart));
+			tokenStart = i + 1;
+		}
+	}
+
+	fields.push_back(line.substr(tokenStart));
+
+	return fields;
+}
+
+/**
+ * Record the exception being handled as the pipeline's error, unless an
+ * earlier stage already failed, and tell every stage to stop.
+ */
+void LoadPipeline::fail() {
+	std::lock_guard<std::mutex> guard(errorLock);
+
+	if (!error) {
+		error = std::current_exception();
+	}
+
+	failed.store(true);
+}
+
+/**
+ * First stage: read the file in batches of lines.
+ */
+void LoadPipeline::readLines() {
+	try {
+		LineBatch batch;
+		std::string line;
+		std::streamoff consumed;
+		bool terminated;
+
+		batch.reserve(BATCH_SIZE);
+
+		while (!failed.load(std::memory_order_relaxed) && readLine(file, &line, &consumed, &terminated)) {
+			// A last line without a newline may still be being written. The resume
+			// offset stays before it so the next load reads it again, whole. A load
+			// from the top still takes it, since many files just lack a final newline;
+			// a load that resumes skips it, as a half-written row would be rejected.
+			if (!terminated && startOffset != headerEnd) {
+				break;
+			}
+			if (terminated) {
+				endOffset += consumed;
+			}
+
+			if (line.empty()) {
+				continue;
+			}
+
+			batch.push_back(line);
+
+			if (batch.size() == BATCH_SIZE) {
+				lines.Push(batch, failed);
+				batch.clear();
+				batch.reserve(BATCH_SIZE);
+			}
+		}
+
+		if (!batch.empty()) {
+			lines.Push(batch, failed);
+		}
+	}
+	catch (...) {
+		fail();
+	}
+
+	lines.Close();
+}
+
+/**
+ * Second stage: split each line into fields.
+ */
+void LoadPipeline::tokenize() {
+	try {
+		LineBatch batch;
+
+		while (lines.Pop(&batch, failed)) {
+			RowBatch rowBatch;
+			rowBatch.reserve(batch.size());
+
+			for (size_t i = 0; i < batch.size(); i++) {
+				rowBatch.push_back(SplitRow(batch[i]));
+
+				// if value(s) missing
+				if (rowBatch.back().size() != columns) {
+					throw csv::Error("corrupted data !");
+				}
+			}
+
+			rows.Push(rowBatch, failed);
+		}
+	}
+	catch (...) {
+		fail();
+	}
+
+	rows.Close();
+}
+
+/**
+ * Third stage: convert the fields of each row into a bid.
+ */
+void LoadPipeline::convert() {
+	try {
+		RowBatch batch;
+
+		while (rows.Pop(&batch, failed)) {
+			BidBatch bidBatch(batch.size());
+
+			for (size_t i = 0; i < batch.size(); i++) {
+				bidBatch[i].bidId = batch[i][1];
+				bidBatch[i].title = batch[i][0];
+				bidBatch[i].fund = batch[i][8];
+				bidBatch[i].department = batch[i][2];
+				bidBatch[i].amount = BST::strToDouble(batch[i][4], '$');
+				bidBatch[i].closeDate = BST::parseDate(batch[i][3]);
+			}
+
+			bids.Push(bidBatch, failed);
+		}
+	}
+	catch (...) {
+		fail();
+	}
+
+	bids.Close();
+}
+
+/**
+ * Load the bids in the file into a tree, starting at the resume offset. The
+ * calling thread stores the bids while the other stages run on their own threads.
+ * @param bst: The tree to store the bids in.
+ * @return The offset just past the last newline read, to resume from next time.
+ * @throws csv::Error if the file can't be read or a row is malformed.
+ */
+std::streamoff LoadPipeline::Run(BinarySearchTree* bst) {
+	// Binary mode keeps byte offsets exact; line endings are handled by readLine.
+	file.open(csvPath.c_str(), std::ios::in | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw csv::Error(std::string("Failed to open ").append(csvPath));
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff fileSize = file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	// Read the header here so the tokenizer knows how many fields a row needs.
+	std::string header;
+	std::streamoff consumed;
+	bool terminated = true;
+
+	headerEnd = 0;
+
+	while (header.empty() && terminated && readLine(file, &header, &consumed, &terminated)) {
+		headerEnd += consumed;
+	}
+
+	if (header.empty()) {
+		throw csv::Error(std::string("No Data in ").append(csvPath));
+	}
+
+	std::stringstream ss(header);
+	std::string item;
+
+	while (std::getline(ss, item, ',')) {
+		++columns;
+	}
+
+	if (columns < 9) {
+		throw csv::Error(std::string("Missing bid columns in ").append(csvPath));
+	}
+
+	// Skip the rows read last time. Every load stops just after a newline, so a
+	// file that is smaller than before or has no newline there was replaced, and is read whole.
+	bool resume = false;
+
+	if (startOffset > headerEnd && startOffset <= fileSize) {
+		char before = 0;
+
+		file.seekg(startOffset - 1);
+		resume = file.get(before) && before == '\n';
+	}
+
+	if (!resume) {
+		startOffset = headerEnd;
+	}
+
+	file.clear();
+	file.seekg(startOffset);
+
+	endOffset = startOffset;
+
+	std::thread reader(&LoadPipeline::readLines, this);
+	std::thread tokenizer(&LoadPipeline::tokenize, this);
+	std::thread converter(&LoadPipeline::convert, this);
+
+	// Last stage: insert the bids into the tree.
+	try {
+		BidBatch batch;
+
+		while (bids.Pop(&batch, failed)) {
+			// Upsert, so reading a row again replaces the bid instead of adding a copy.
+			for (size_t i = 0; i < batch.size(); i++) {
+				if (bst->Upsert(batch[i]) == BID_REJECTED && rejected++ == 0) {
+					firstRejected = batch[i].bidId;
+				}
+			}
+		}
+	}
+	catch (...) {
+		fail();
+	}
+
+	reader.join();
+	tokenizer.join();
+	converter.join();
+	file.close();
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+
+	return endOffset;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Bid.hpp"
+#include "BinarySearchTree.hpp"
+#include "SpscQueue.hpp"
+
+/**
+ * Define a staged loader for bid CSV files. File reading, tokenizing and field
+ * conversion each run on their own thread and hand batches to the next stage
+ * through bounded queues, while the calling thread upserts into the tree. The
+ * first error raised by any stage stops the others and is rethrown by Run.
+ * Rows whose id the tree can't key on are skipped and counted instead.
+ *
+ * Loading can resume from the byte offset a previous Run stopped at, so a file
+ * that only grows by appended rows is never parsed twice. The one exception is
+ * a last row without a newline, which is read again once it has one.
+ */
+class LoadPipeline {
+
+private:
+	typedef std::vector<std::string> LineBatch;
+	typedef std::vector<std::vector<std::string> > RowBatch;
+	typedef std::vector<Bid> BidBatch;
+
+	std::string csvPath;
+	std::ifstream file;
+	size_t columns;
+	std::streamoff startOffset;
+	std::streamoff headerEnd;
+	std::streamoff endOffset;
+
+	SpscQueue<LineBatch> lines;
+	SpscQueue<RowBatch> rows;
+	SpscQueue<BidBatch> bids;
+
+	size_t rejected;
+	std::string firstRejected;
+
+	std::atomic<bool> failed;
+	std::mutex errorLock;
+	std::exception_ptr error;
+
+	void readLines();
+	void tokenize();
+	void convert();
+	void fail();
+
+public:
+	LoadPipeline(const std::string& csvPath, std::streamoff offset = 0);
+	std::streamoff Run(BinarySearchTree* bst);
+	size_t Rejected() const { return rejected; }
+	const std::string& FirstRejected() const { return firstRejected; }
+
+	static std::vector<std::string> SplitRow(const std::string& line);
+};
@@ -0,0 +1,414 @@
+/**
+ * Regression checks for loading and combining bids: date parsing, the staged
+ * CSV loader, resuming a load at a byte offset, and merging trees whose ids
+ * overlap. Built as its own program next to the app.
+ *
+ * The loader runs its stages on their own threads; build with
+ * -fsanitize=thread to have data races between them reported as well. The
+ * CSV files it reads are written to the working directory and removed again.
+ *
+ * Returns 0 if every check passed.
+ */
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "BinarySearchTree.hpp"
+#include "CSVparser/CSVparser.hpp"
+#include "LoadPipeline.hpp"
+#include "StaticMethods.hpp"
+#include "TreeSnapshot.hpp"
+
+namespace
+{
+	typedef std::map<uint32_t, Bid> Expected;
+
+	const char* const CSV_PATH = "LoadTest.csv";
+	const char* const HEADER = "ArticleTitle,ArticleID,Department ,CloseDate ,WinningBid ,InventoryID,VehicleID,ReceiptNumber ,Fund\n";
+
+	int failures = 0;
+
+	/**
+	 * Record a failed check
+	 *
+	 * @param passed: The result of the check.
+	 * @param what: Describes the check, printed if it failed.
+	 */
+	void expect(bool passed, const std::string& what)
+	{
+		if (!passed) {
+			if (failures++ < 20) {
+				std::cerr << "FAILED: " << what << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * Make a bid with random fields. Amounts are whole cents, so they read
+	 * back from the CSV text exactly.
+	 */
+	Bid randomBid(std::mt19937& rng, uint32_t key)
+	{
+		static const char* const FUNDS[] = { "General Fund", "Enterprise", "Special Revenue" };
+		Bid bid;
+
+		bid.bidId = std::to_string(key);
+		bid.title = "Title " + std::to_string(rng() % 100000);
+		bid.fund = FUNDS[rng() % 3];
+		bid.department = FUNDS[rng() % 3];
+		bid.amount = (rng() % 100000) / 100.0;
+		bid.closeDate = BST::parseDate("1/1/2016") + (int32_t)(rng() % 400);
+
+		return bid;
+	}
+
+	/**
+	 * Write a bid as a CSV row, in the column order of the monthly files.
+	 */
+	std::string csvRow(const Bid& bid)
+	{
+		char amount[32];
+		snprintf(amount, sizeof(amount), "$%.2f ", bid.amount);
+
+		return bid.title + "," + bid.bidId + "," + bid.department + "," + BST::formatDate(bid.closeDate) + "," + amount + ",X,,1," + bid.fund + "\n";
+	}
+
+	/**
+	 * Check that a bid in a tree matches the one expected
+	 */
+	bool sameBid(const Bid& found, const Bid& bid)
+	{
+		return found.bidId == bid.bidId && found.title == bid.title && found.fund == bid.fund
+			&& found.department == bid.department && found.amount == bid.amount && found.closeDate == bid.closeDate;
+	}
+
+	/**
+	 * Check that a tree holds exactly the expected bids
+	 *
+	 * @param what: Names the tree in failure messages.
+	 */
+	void checkTree(BinarySearchTree& tree, const Expected& expected, const std::string& what)
+	{
+		bool matches = tree.Size() == (int)expected.size();
+
+		for (Expected::const_iterator it = expected.begin(); matches && it != expected.end(); ++it) {
+			matches = sameBid(tree.Search(it->second.bidId), it->second);
+		}
+
+		expect(matches, what + " holds the expected bids");
+	}
+
+	/**
+	 * Write text to the test CSV file
+	 *
+	 * @param text: The text to write.
+	 * @param append: Add to the end of the file rather than replacing it.
+	 */
+	void writeCsv(const std::string& text, bool append)
+	{
+		std::ofstream file(CSV_PATH, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+		file << text;
+	}
+
+	/**
+	 * Check date parsing against known days, invalid dates and a round trip
+	 * through formatDate
+	 */
+	void dates()
+	{
+		expect(BST::parseDate("1/1/1970") == 0, "1/1/1970 is day 0");
+		expect(BST::parseDate("12/1/16") == 17136 && BST::parseDate("12/1/2016") == 17136, "Two-digit years are in the 2000s");
+		expect(BST::parseDate(" 2/29/2016 ") == 16860, "Leap days parse, with spaces around the date");
+		expect(BST::parseDate("12/31/1969") == -1, "Days before 1970 are negative");
+		expect(BST::formatDate(17136) == "12/1/2016" && BST::formatDate(NO_DATE).empty(), "formatDate writes M/D/YYYY");
+
+		const char* const INVALID[] = { "", "  ", "2/29/2015", "2/29/1900", "13/1/16", "0/1/16", "1/0/16", "4/31/16", "1//16", "1/2/3/4", "1/2", "x", "1/2/16x", "12345/1/16" };
+
+		for (size_t i = 0; i < sizeof(INVALID) / sizeof(INVALID[0]); i++) {
+			expect(BST::parseDate(INVALID[i]) == NO_DATE, std::string("\"") + INVALID[i] + "\" is not a date");
+		}
+
+		bool roundTrips = true;
+
+		for (int32_t day = BST::parseDate("1/1/1000"); day < BST::parseDate("12/31/9999"); day += 13) {
+			roundTrips = roundTrips && BST::parseDate(BST::formatDate(day)) == day;
+		}
+
+		expect(roundTrips, "formatDate and parseDate round trip");
+	}
+
+	/**
+	 * Load a large file through the staged loader, with repeated ids and rows
+	 * whose id can't be a key, then the same file with a malformed row
+	 */
+	void stagedLoad()
+	{
+		const int ROWS = 300000;
+
+		std::mt19937 rng(3);
+		std::string text = HEADER;
+		Expected expected;
+
+		for (int i = 0; i < ROWS; i++) {
+			// Later rows with the same id replace earlier ones.
+			Bid bid = randomBid(rng, rng() % (ROWS / 2));
+
+			text += csvRow(bid);
+			expected[std::stoul(bid.bidId)] = bid;
+		}
+
+		Bid unusable = randomBid(rng, 0);
+		const char* const IDS[] = { "007", "abc", "", "4294967296" };
+
+		for (size_t i = 0; i < sizeof(IDS) / sizeof(IDS[0]); i++) {
+			unusable.bidId = IDS[i];
+			text += csvRow(unusable);
+		}
+
+		writeCsv(text, false);
+
+		{
+			BinarySearchTree tree;
+			LoadPipeline pipeline(CSV_PATH);
+
+			pipeline.Run(&tree);
+			checkTree(tree, expected, "A tree loaded in stages");
+			expect(pipeline.Rejected() == 4 && pipeline.FirstRejected() == "007", "The loader counts rows with unusable ids");
+		}
+
+		// Cut a field from a row partway through the file.
+		size_t middle = text.find('\n', text.size() / 2);
+		size_t comma = text.rfind(',', text.find('\n', middle + 1));
+		text.erase(comma, text.find('\n', comma) - comma);
+		writeCsv(text, false);
+
+		{
+			BinarySearchTree tree;
+			LoadPipeline pipeline(CSV_PATH);
+			bool threw = false;
+
+			try {
+				pipeline.Run(&tree);
+			}
+			catch (csv::Error&) {
+				threw = true;
+			}
+
+			expect(threw, "A malformed row stops the load with csv::Error");
+			expect(tree.Size() < (int)expected.size(), "Rows after a malformed one are not loaded");
+		}
+	}
+
+	/**
+	 * Resume loading a file that grows, including while its last row is only
+	 * partly written
+	 */
+	void resumedLoad()
+	{
+		std::mt19937 rng(4);
+		Expected expected;
+		std::string text = HEADER;
+
+		for (uint32_t key = 1; key <= 100; key++) {
+			Bid bid = randomBid(rng, key);
+			text += csvRow(bid);
+			expected[key] = bid;
+		}
+
+		// The writer is caught partway through the fund of row 101. The row is
+		// read as it stands, then read again once it has its newline.
+		Bid half = randomBid(rng, 101);
+		std::string row = csvRow(half);
+
+		writeCsv(text + row.substr(0, row.size() - 5), false);
+		expected[101] = half;
+		expected[101].fund.erase(half.fund.size() - 4);
+
+		BinarySearchTree tree;
+		std::streamoff offset = LoadPipeline(CSV_PATH).Run(&tree);
+
+		checkTree(tree, expected, "A tree loaded from a file ending in a partial row");
+
+		writeCsv(row.substr(row.size() - 5), true);
+
+		for (uint32_t key = 102; key <= 110; key++) {
+			Bid bid = randomBid(rng, key);
+			writeCsv(csvRow(bid), true);
+			expected[key] = bid;
+		}
+		expected[101] = half;
+
+		std::streamoff next = LoadPipeline(CSV_PATH, offset).Run(&tree);
+
+		checkTree(tree, expected, "A tree resumed once the partial row was finished");
+		expect(next > offset, "A resumed load moves the offset on");
+
+		// Loading again from the end reads nothing, and new rows read from there.
+		expect(LoadPipeline(CSV_PATH, next).Run(&tree) == next, "Nothing is read when the file has not grown");
+
+		// A resumed load leaves a partial last row for the next one.
+		Bid appended = randomBid(rng, 111);
+		Bid unfinished = randomBid(rng, 112);
+		std::string lastRow = csvRow(unfinished);
+
+		writeCsv(csvRow(appended) + lastRow.substr(0, 10), true);
+		expected[111] = appended;
+		next = LoadPipeline(CSV_PATH, next).Run(&tree);
+		checkTree(tree, expected, "A tree resumed after rows were appended");
+
+		writeCsv(lastRow.substr(10), true);
+		expected[112] = unfinished;
+		next = LoadPipeline(CSV_PATH, next).Run(&tree);
+		checkTree(tree, expected, "A tree resumed once the last row was finished");
+
+		// Rows before the offset are not read again: change the first row's title in place.
+		{
+			std::fstream file(CSV_PATH, std::ios::in | std::ios::out | std::ios::binary);
+			file.seekp(std::string(HEADER).size());
+			file.put('X');
+		}
+
+		LoadPipeline(CSV_PATH, next).Run(&tree);
+		expect(tree.Search("1").title == expected[1].title, "A resumed load skips the rows before its offset");
+
+		// A replaced file whose offset no longer follows a newline is read from the start.
+		Bid replaced = randomBid(rng, 1);
+		writeCsv(std::string(HEADER) + csvRow(replaced) + text.substr(std::string(HEADER).size() + csvRow(expected[1]).size()), false);
+		bool startedOver = true;
+
+		try {
+			// The offset falls inside the first row.
+			LoadPipeline(CSV_PATH, std::string(HEADER).size() + 5).Run(&tree);
+		}
+		catch (csv::Error&) {
+			startedOver = false;
+		}
+
+		expect(startedOver && sameBid(tree.Search("1"), replaced), "A load resumed mid-row starts over");
+	}
+
+	/**
+	 * Merge a tree into another where their ids overlap, with and without the
+	 * optional indexes built, then keep changing the merged tree
+	 *
+	 * @param seed: Seeds the random changes, so a failure can be repeated.
+	 */
+	void overlappingMerge(unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		BinarySearchTree tree;
+		BinarySearchTree other;
+		Expected expected;
+		bool indexed = (seed % 2) != 0;
+
+		if (indexed) {
+			tree.BuildSecondaryIndexes();
+			tree.BuildTitleIndex();
+			tree.BuildHashIndex();
+		}
+
+		for (int i = 0; i < 200; i++) {
+			Bid bid = randomBid(rng, rng() % 1000);
+			tree.Upsert(bid);
+			expected[std::stoul(bid.bidId)] = bid;
+		}
+
+		// Every third round the id ranges don't meet at all.
+		uint32_t otherStart = (seed % 3 == 0) ? 5000 : 300;
+		Expected incoming;
+
+		for (int i = 0; i < 200; i++) {
+			Bid bid = randomBid(rng, otherStart + rng() % 1000);
+			other.Upsert(bid);
+			incoming[std::stoul(bid.bidId)] = bid;
+		}
+
+		// Leave the other tree free and retired slots to carry over.
+		std::shared_ptr<TreeSnapshot> snapshot;
+
+		if (rng() % 2) {
+			snapshot = other.Snapshot();
+		}
+		for (int i = 0; i < 50; i++) {
+			uint32_t key = otherStart + rng() % 1000;
+			other.Remove(std::to_string(key));
+			incoming.erase(key);
+		}
+
+		// The incoming bid wins where both trees hold an id.
+		for (Expected::iterator it = incoming.begin(); it != incoming.end(); ++it) {
+			expected[it->first] = it->second;
+		}
+
+		tree.Merge(&other);
+		checkTree(tree, expected, "A merged tree");
+
+		double total = 0.0;
+
+		for (Expected::iterator it = expected.begin(); it != expected.end(); ++it) {
+			total += it->second.amount;
+		}
+
+		std::vector<Rollup> days = tree.DailyTotals("1/1/2016", "12/31/2017");
+		size_t counted = 0;
+		double summed = 0.0;
+
+		for (size_t i = 0; i < days.size(); i++) {
+			counted += days[i].count;
+			summed += days[i].amount;
+		}
+
+		expect(std::fabs(tree.TotalAmount() - total) < 1e-6, "A merged tree's total matches its bids");
+		expect(counted == expected.size() && std::fabs(summed - total) < 1e-6, "A merged tree's daily totals match its bids");
+		expect(tree.ClosedBetween("1/1/2016", "12/31/2017").size() == expected.size(), "A merged tree's close dates cover its bids");
+
+		if (indexed) {
+			size_t byFund = tree.FindByFund("General Fund").size() + tree.FindByFund("Enterprise").size() + tree.FindByFund("Special Revenue").size();
+			std::vector<uint32_t> handles;
+
+			tree.FindByTitlePrefix("title", &handles);
+			expect(byFund == expected.size(), "A merged tree's fund index covers its bids");
+			expect(handles.size() == expected.size(), "A merged tree's title index covers its bids");
+		}
+
+		// Removing and adding bids afterwards reuses the slots the merge brought in.
+		for (int i = 0; i < 100; i++) {
+			uint32_t key = rng() % 6000;
+			tree.Remove(std::to_string(key));
+			expected.erase(key);
+		}
+		for (int i = 0; i < 100; i++) {
+			Bid bid = randomBid(rng, rng() % 6000);
+			tree.Upsert(bid);
+			expected[std::stoul(bid.bidId)] = bid;
+		}
+
+		checkTree(tree, expected, "A merged tree changed afterwards");
+	}
+}
+
+int main()
+{
+	dates();
+	stagedLoad();
+	resumedLoad();
+
+	for (unsigned seed = 1; seed <= 60; seed++) {
+		overlappingMerge(seed);
+	}
+
+	std::remove(CSV_PATH);
+
+	if (failures > 0) {
+		std::cout << failures << " checks failed." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All load checks passed." << std::endl;
+	return 0;
+}
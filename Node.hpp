@@ -1,12 +1,32 @@
 #pragma once
-#include "Bid.hpp"
+#include <cstdint>
 
 /**
- * Define nodes to place in the tree structure. 
+ * Index used in place of a null pointer for nodes and bid handles.
  */
-struct Node {
-	Bid* bid;
-	Node* left;
-	Node* right;
+const uint32_t NIL_INDEX = 0xFFFFFFFF;
+
+/**
+ * Summarize the amounts of a set of bids. An empty set has a count and sum
+ * of zero, a minimum of infinity and a maximum of minus infinity.
+ */
+struct Aggregate {
+	uint32_t count;
+	double sum;
+	double min;
+	double max;
 };
 
+/**
+ * Define nodes to place in the tree structure. Nodes live in a pool owned by
+ * the tree and refer to their children and their bid by 32-bit index. The
+ * epoch records which tree version created the node, and total summarizes
+ * the amounts of every bid in the node's subtree.
+ */
+struct Node {
+	uint32_t bid;
+	uint32_t left;
+	uint32_t right;
+	uint32_t epoch;
+	Aggregate total;
+};
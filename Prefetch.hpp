@@ -0,0 +1,23 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#endif
+
+namespace BST
+{
+	/**
+	 * Hint to the processor that an address will be read soon.
+	 * @param address: The address to fetch into cache.
+	 */
+	inline void prefetch(const void* address)
+	{
+#if defined(_M_X64) || defined(_M_IX86)
+		_mm_prefetch((const char*)address, _MM_HINT_T0);
+#elif defined(__GNUC__)
+		__builtin_prefetch(address);
+#else
+		(void)address;
+#endif
+	}
+}
@@ -0,0 +1,600 @@
+#include "RequestServer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+	// Runs of lookups shorter than this are answered on the calling thread; handing them off costs more than they do.
+	const size_t MIN_PARALLEL = 256;
+
+	// How long blocking socket calls wait before checking whether the server is stopping.
+	const int POLL_MILLISECONDS = 200;
+
+	/**
+	 * Format an amount with two decimal places.
+	 */
+	std::string formatAmount(double amount) {
+		char text[64];
+		snprintf(text, sizeof(text), "%.2f", amount);
+		return text;
+	}
+
+	/**
+	 * Describe a bid found by a lookup.
+	 */
+	std::string describe(const BidStore& bids, uint32_t handle) {
+		return "OK\t" + std::to_string(bids.Key(handle)) + "\t" + bids.Title(handle) + "\t" + bids.Fund(handle) + "\t" + formatAmount(bids.Amount(handle));
+	}
+
+	/**
+	 * Get the operation letter a request starts with.
+	 */
+	std::string operation(const std::string& request) {
+		std::istringstream fields(request);
+		std::string op;
+
+		fields >> op;
+		return op;
+	}
+
+	/**
+	 * A socket client's thread, and whether it has finished so it can be joined.
+	 */
+	struct Connection {
+		std::thread thread;
+		std::atomic<bool> finished;
+
+		Connection() : finished(false) {
+		}
+	};
+
+	/**
+	 * Remove the carriage return left on a line by clients sending CRLF line ends.
+	 */
+	void trimLine(std::string* line) {
+		if (!line->empty() && (*line)[line->size() - 1] == '\r') {
+			line->erase(line->size() - 1);
+		}
+	}
+}
+
+/**
+ * Constructor
+ * @param bst: The tree to answer requests against.
+ * @param workers: The number of threads sharing a run of lookups, or 0 for one per processor.
+ */
+RequestServer::RequestServer(BinarySearchTree* bst, unsigned workers) : stopping(false), served(0) {
+	this->bst = bst;
+	this->workers = (workers > 0) ? workers : std::max(1u, std::thread::hardware_concurrency());
+	busyBatches = 0;
+	busy = std::chrono::steady_clock::duration::zero();
+	closing = false;
+
+	for (unsigned i = 1; i < this->workers; i++) {
+		pool.push_back(std::thread(&RequestServer::work, this));
+	}
+}
+
+/**
+ * Destructor
+ */
+RequestServer::~RequestServer() {
+	{
+		std::lock_guard<std::mutex> guard(taskLock);
+		closing = true;
+	}
+	taskReady.notify_all();
+
+	for (size_t i = 0; i < pool.size(); i++) {
+		pool[i].join();
+	}
+}
+
+/**
+ * Run tasks from the queue until the server is destroyed. The body of each pool thread.
+ */
+void RequestServer::work() {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> guard(taskLock);
+			taskReady.wait(guard, [this]() { return closing || !tasks.empty(); });
+
+			if (tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+/**
+ * Run jobs on the pool, with the calling thread taking the first, and wait for all of them.
+ * @param jobs: The jobs to run. They must not throw.
+ */
+void RequestServer::runAll(std::vector<std::function<void()> >& jobs) {
+	std::mutex doneLock;
+	std::condition_variable done;
+	size_t remaining = jobs.size() - 1;
+
+	{
+		std::lock_guard<std::mutex> guard(taskLock);
+
+		for (size_t i = 1; i < jobs.size(); i++) {
+			std::function<void()>& job = jobs[i];
+
+			tasks.push_back([&job, &doneLock, &done, &remaining]() {
+				job();
+
+				std::lock_guard<std::mutex> finished(doneLock);
+				if (--remaining == 0) {
+					done.notify_one();
+				}
+			});
+		}
+	}
+	taskReady.notify_all();
+
+	jobs[0]();
+
+	std::unique_lock<std::mutex> guard(doneLock);
+	done.wait(guard, [&remaining]() { return remaining == 0; });
+}
+
+/**
+ * Start timing a batch. Time during which several clients' batches overlap is counted once.
+ */
+void RequestServer::beginBatch() {
+	std::lock_guard<std::mutex> guard(busyLock);
+
+	if (busyBatches++ == 0) {
+		busySince = std::chrono::steady_clock::now();
+	}
+}
+
+/**
+ * Stop timing a batch started with beginBatch.
+ */
+void RequestServer::endBatch() {
+	std::lock_guard<std::mutex> guard(busyLock);
+
+	if (--busyBatches == 0) {
+		busy += std::chrono::steady_clock::now() - busySince;
+	}
+}
+
+/**
+ * Check whether a request only reads the tree, so it may run alongside others.
+ * @param request: The request line.
+ * @return True for lookups, range totals, exports and statistics.
+ */
+bool RequestServer::readOnly(const std::string& request) {
+	std::string op = operation(request);
+
+	return op == "G" || op == "R" || op == "S" || op == "X";
+}
+
+/**
+ * Answer a single request.
+ * @param request: The request line.
+ * @param response: Receives the response line, without the line end.
+ */
+void RequestServer::answer(const std::string& request, std::string* response) {
+	std::istringstream fields(request);
+	std::string op;
+	std::string first;
+	std::string second;
+
+	fields >> op >> first >> second;
+
+	if (op == "R" && !second.empty()) {
+		Aggregate total = bst->AmountsInRange(first, second);
+
+		if (total.count == 0) {
+			*response = "OK\t0\t0.00\t0.00\t0.00";
+			return;
+		}
+
+		*response = "OK\t" + std::to_string(total.count) + "\t" + formatAmount(total.sum) + "\t" + formatAmount(total.min) + "\t" + formatAmount(total.max);
+	}
+	else if (op == "D" && !first.empty()) {
+		bst->Remove(first);
+		*response = "OK";
+	}
+	else if (op == "X") {
+		std::lock_guard<std::mutex> guard(exportLock);
+		bst->InOrderJSON();
+		*response = "OK\tbids.json";
+	}
+	else if (op == "S") {
+		std::ostringstream stats;
+		stats << "OK\t" << Served() << "\t" << Seconds() << "\t" << QueriesPerSecond();
+		*response = stats.str();
+	}
+	else if (op == "Q" || op == "K") {
+		*response = "OK";
+	}
+	else {
+		*response = "ERR\tunknown request";
+	}
+}
+
+/**
+ * Answer a run of read-only requests. Lookups are gathered and passed to the
+ * tree in one batch, so their memory accesses overlap.
+ * @param requests: The batch the run belongs to.
+ * @param first: The index of the first request of the run.
+ * @param last: The index one past the last request of the run.
+ * @param responses: Receives a response at the index of each request.
+ */
+void RequestServer::lookups(const std::vector<std::string>& requests, size_t first, size_t last, std::vector<std::string>* responses) {
+	std::vector<std::string> bidIds;
+	std::vector<size_t> positions;
+	std::vector<uint32_t> handles;
+
+	for (size_t i = first; i < last; i++) {
+		std::istringstream fields(requests[i]);
+		std::string op;
+		std::string bidId;
+
+		fields >> op >> bidId;
+
+		if (op == "G" && !bidId.empty()) {
+			bidIds.push_back(bidId);
+			positions.push_back(i);
+		}
+		else {
+			answer(requests[i], &(*responses)[i]);
+		}
+	}
+
+	bst->SearchBatch(bidIds, &handles);
+
+	const BidStore& bids = bst->Bids();
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		std::string& response = (*responses)[positions[i]];
+		uint32_t handle = handles[i];
+
+		if (handle == NIL_INDEX) {
+			response = "NONE";
+		}
+		else {
+			response = describe(bids, handle);
+		}
+	}
+}
+
+/**
+ * Answer a batch of requests in order. Runs of read-only requests are split
+ * between the worker threads; each request that changes the tree runs alone.
+ * @param requests: The request lines.
+ * @param responses: Receives one response line per request.
+ * @param quit: Set if the batch ends the session. Requests after the Q or K are not answered.
+ */
+void RequestServer::handleBatch(const std::vector<std::string>& requests, std::vector<std::string>* responses, bool* quit) {
+	beginBatch();
+
+	size_t count = requests.size();
+
+	// Nothing after a quit is answered.
+	for (size_t i = 0; i < requests.size(); i++) {
+		std::string op = operation(requests[i]);
+
+		if (op == "Q" || op == "K") {
+			count = i + 1;
+			*quit = true;
+
+			if (op == "K") {
+				Stop();
+			}
+			break;
+		}
+	}
+
+	responses->assign(count, std::string());
+
+	size_t start = 0;
+
+	while (start < count) {
+		size_t end = start;
+
+		while (end < count && readOnly(requests[end])) {
+			++end;
+		}
+
+		if (end == start) {
+			// A request that changes the tree waits for every reader in flight.
+			std::unique_lock<std::shared_timed_mutex> exclusive(treeLock);
+			answer(requests[start], &(*responses)[start]);
+			++start;
+			continue;
+		}
+
+		std::shared_lock<std::shared_timed_mutex> shared(treeLock);
+		size_t length = end - start;
+		size_t threads = std::min<size_t>(workers, length / MIN_PARALLEL);
+
+		if (threads <= 1) {
+			lookups(requests, start, end, responses);
+		}
+		else {
+			std::vector<std::function<void()> > jobs;
+			size_t slice = (length + threads - 1) / threads;
+
+			for (size_t first = start; first < end; first += slice) {
+				size_t last = std::min(end, first + slice);
+
+				jobs.push_back([this, &requests, first, last, responses]() { lookups(requests, first, last, responses); });
+			}
+
+			runAll(jobs);
+		}
+
+		start = end;
+	}
+
+	served += count;
+	endBatch();
+}
+
+/**
+ * Answer requests read from a stream until it ends or a Q request arrives.
+ * Every line already buffered is handled as one batch, so a client that
+ * sends requests without waiting for responses gets them answered together.
+ * @param in: The stream of request lines. For std::cin, call
+ *     std::ios::sync_with_stdio(false) first so waiting input is buffered.
+ * @param out: The stream the responses are written to.
+ */
+void RequestServer::Serve(std::istream& in, std::ostream& out) {
+	std::vector<std::string> requests;
+	std::vector<std::string> responses;
+	std::string line;
+	bool quit = false;
+
+	while (!quit && std::getline(in, line)) {
+		requests.clear();
+		trimLine(&line);
+		requests.push_back(line);
+
+		while (requests.size() < MAX_BATCH && in.rdbuf()->in_avail() > 0 && std::getline(in, line)) {
+			trimLine(&line);
+			requests.push_back(line);
+		}
+
+		handleBatch(requests, &responses, &quit);
+
+		for (size_t i = 0; i < responses.size(); i++) {
+			out << responses[i] << '\n';
+		}
+		out.flush();
+	}
+}
+
+#ifndef _WIN32
+
+/**
+ * Answer the requests of one socket client until it disconnects, sends Q,
+ * or the server stops.
+ * @param client: The connected socket, closed on return.
+ */
+void RequestServer::serveConnection(int client) {
+	std::string pending;
+	std::string output;
+	std::vector<std::string> requests;
+	std::vector<std::string> responses;
+	char buffer[65536];
+	bool quit = false;
+	bool closed = false;
+
+	while (!quit && !closed && !stopping) {
+		pollfd ready = { client, POLLIN, 0 };
+
+		if (poll(&ready, 1, POLL_MILLISECONDS) <= 0) {
+			continue;
+		}
+
+		ssize_t received = read(client, buffer, sizeof(buffer));
+
+		if (received <= 0) {
+			// Answer a last request the client sent without a line end.
+			closed = true;
+			if (!pending.empty()) {
+				pending += '\n';
+			}
+		}
+		else {
+			pending.append(buffer, (size_t)received);
+		}
+
+		// Take every complete line received so far, in batches.
+		size_t lineStart = 0;
+		size_t lineEnd;
+
+		while (!quit && (lineEnd = pending.find('\n', lineStart)) != std::string::npos) {
+			requests.clear();
+
+			do {
+				std::string line = pending.substr(lineStart, lineEnd - lineStart);
+				trimLine(&line);
+				requests.push_back(line);
+				lineStart = lineEnd + 1;
+			} while (requests.size() < MAX_BATCH && (lineEnd = pending.find('\n', lineStart)) != std::string::npos);
+
+			handleBatch(requests, &responses, &quit);
+
+			output.clear();
+			for (size_t i = 0; i < responses.size(); i++) {
+				output += responses[i];
+				output += '\n';
+			}
+
+			for (size_t sent = 0; sent < output.size();) {
+				ssize_t written = write(client, output.data() + sent, output.size() - sent);
+
+				if (written <= 0) {
+					closed = true;
+					break;
+				}
+				sent += (size_t)written;
+			}
+		}
+
+		pending.erase(0, lineStart);
+	}
+
+	close(client);
+}
+
+/**
+ * Listen on a Unix-domain socket and answer each client on its own thread,
+ * until a client sends K.
+ * @param path: The file system path of the socket. An old socket file there is replaced.
+ * @return False if the socket could not be created.
+ */
+bool RequestServer::ServeSocket(const std::string& path) {
+	sockaddr_un address;
+
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path is too long: " << path << std::endl;
+		return false;
+	}
+
+	// A client that disconnects early must not end the server.
+	signal(SIGPIPE, SIG_IGN);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0) {
+		std::cerr << "Could not create socket: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+	unlink(path.c_str());
+
+	if (bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, SOMAXCONN) < 0) {
+		std::cerr << "Could not listen on " << path << ": " << strerror(errno) << std::endl;
+		close(listener);
+		return false;
+	}
+
+	std::list<Connection> clients;
+
+	while (!stopping) {
+		// Join the threads of clients that have gone, so a long-running server does not keep them.
+		for (std::list<Connection>::iterator it = clients.begin(); it != clients.end();) {
+			if (it->finished) {
+				it->thread.join();
+				it = clients.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		pollfd ready = { listener, POLLIN, 0 };
+
+		if (poll(&ready, 1, POLL_MILLISECONDS) <= 0) {
+			continue;
+		}
+
+		int client = accept(listener, nullptr, nullptr);
+
+		if (client >= 0) {
+			clients.emplace_back();
+			Connection& connection = clients.back();
+
+			connection.thread = std::thread([this, client, &connection]() {
+				serveConnection(client);
+				connection.finished = true;
+			});
+		}
+	}
+
+	close(listener);
+	unlink(path.c_str());
+
+	for (std::list<Connection>::iterator it = clients.begin(); it != clients.end(); ++it) {
+		it->thread.join();
+	}
+
+	return true;
+}
+
+#else
+
+/**
+ * Unix-domain sockets are not served on Windows; use Serve with stdin instead.
+ * @return False.
+ */
+bool RequestServer::ServeSocket(const std::string& path) {
+	std::cerr << "Serving on a socket is not supported on this platform: " << path << std::endl;
+	return false;
+}
+
+void RequestServer::serveConnection(int client) {
+}
+
+#endif
+
+/**
+ * Stop serving. ServeSocket returns once its clients have finished their current batch.
+ */
+void RequestServer::Stop() {
+	stopping = true;
+}
+
+/**
+ * Get the number of requests answered so far.
+ * @return The number of requests.
+ */
+uint64_t RequestServer::Served() const {
+	return served;
+}
+
+/**
+ * Get the time spent handling batches of requests, leaving out the time spent
+ * waiting for clients to send them.
+ * @return The time in seconds.
+ */
+double RequestServer::Seconds() const {
+	std::lock_guard<std::mutex> guard(busyLock);
+	std::chrono::steady_clock::duration total = busy;
+
+	if (busyBatches > 0) {
+		total += std::chrono::steady_clock::now() - busySince;
+	}
+
+	return std::chrono::duration<double>(total).count();
+}
+
+/**
+ * Get the throughput while handling requests.
+ * @return The number of requests answered per second of handling time.
+ */
+double RequestServer::QueriesPerSecond() const {
+	double seconds = Seconds();
+
+	return (seconds > 0.0) ? Served() / seconds : 0.0;
+}
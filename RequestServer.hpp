@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinarySearchTree.hpp"
+
+/**
+ * Define a server answering requests against a loaded tree without the menu,
+ * either from a stream such as stdin or from clients of a local Unix-domain
+ * socket. Each request is one line and gets exactly one response line, in the
+ * same order:
+ *
+ *   G <bidId>          OK <bidId> <title> <fund> <amount>, or NONE
+ *   R <loId> <hiId>    OK <count> <sum> <min> <max> of the amounts in the id range
+ *   D <bidId>          OK once the bid is removed
+ *   X                  OK bids.json once the tree is exported
+ *   S                  OK <requests> <seconds> <queries per second>, counting
+ *                      requests answered before this batch and the time spent
+ *                      handling batches, not the time spent waiting for them
+ *   Q                  OK, then the session ends
+ *   K                  OK, then the session ends and the server stops
+ *
+ * Response fields are separated by tabs. Clients may send many requests
+ * without waiting for the responses; whatever has arrived is taken as one
+ * batch, and runs of lookups within a batch are shared out between worker
+ * threads. Exports write from a snapshot, so they run alongside lookups;
+ * only removes wait for the requests before them to finish.
+ */
+class RequestServer {
+
+private:
+	BinarySearchTree* bst;
+	unsigned workers;
+	std::shared_timed_mutex treeLock; // shared while requests read the tree, exclusive while one changes it
+	std::mutex exportLock; // exports all write the same file
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> served;
+	mutable std::mutex busyLock;
+	unsigned busyBatches; // batches being handled now
+	std::chrono::steady_clock::time_point busySince; // when busyBatches last rose from zero
+	std::chrono::steady_clock::duration busy; // time spent handling batches before busySince
+
+	std::vector<std::thread> pool; // workers - 1 threads; the thread handling a batch is the last worker
+	std::deque<std::function<void()> > tasks;
+	std::mutex taskLock;
+	std::condition_variable taskReady;
+	bool closing;
+
+	static bool readOnly(const std::string& request);
+	void work();
+	void runAll(std::vector<std::function<void()> >& jobs);
+	void beginBatch();
+	void endBatch();
+	void answer(const std::string& request, std::string* response);
+	void lookups(const std::vector<std::string>& requests, size_t first, size_t last, std::vector<std::string>* responses);
+	void handleBatch(const std::vector<std::string>& requests, std::vector<std::string>* responses, bool* quit);
+	void serveConnection(int client);
+
+public:
+	static const size_t MAX_BATCH = 4096;
+
+	RequestServer(BinarySearchTree* bst, unsigned workers = 0);
+	virtual ~RequestServer();
+	void Serve(std::istream& in, std::ostream& out);
+	bool ServeSocket(const std::string& path);
+	void Stop();
+	uint64_t Served() const;
+	double Seconds() const;
+	double QueriesPerSecond() const;
+};
@@ -0,0 +1,108 @@
+#include "SecondaryIndex.hpp"
+
+/**
+ * Add a bid to both indexes.
+ * @param handle: The handle of the bid.
+ * @param fund: The code of the bid's fund.
+ * @param amount: The bid's amount.
+ */
+void SecondaryIndex::Add(uint32_t handle, uint32_t fund, double amount) {
+	if (handle >= entries.size()) {
+		Entry empty = { NOT_INDEXED, 0, amounts.end() };
+		entries.resize(handle + 1, empty);
+	}
+	else if (entries[handle].fund != NOT_INDEXED) {
+		Remove(handle);
+	}
+
+	if (fund >= funds.size()) {
+		funds.resize(fund + 1);
+	}
+
+	entries[handle].fund = fund;
+	entries[handle].position = (uint32_t)funds[fund].size();
+	entries[handle].amount = amounts.insert(std::make_pair(amount, handle));
+	funds[fund].push_back(handle);
+}
+
+/**
+ * Remove a bid from both indexes. Handles that are not indexed are ignored.
+ * @param handle: The handle of the bid.
+ */
+void SecondaryIndex::Remove(uint32_t handle) {
+	if (handle >= entries.size() || entries[handle].fund == NOT_INDEXED) {
+		return;
+	}
+
+	Entry& entry = entries[handle];
+	std::vector<uint32_t>& postings = funds[entry.fund];
+
+	// Move the last posting into the removed one's place.
+	uint32_t last = postings.back();
+	postings[entry.position] = last;
+	entries[last].position = entry.position;
+	postings.pop_back();
+
+	amounts.erase(entry.amount);
+	entry.fund = NOT_INDEXED;
+	entry.amount = amounts.end();
+}
+
+/**
+ * Remove every bid from both indexes.
+ */
+void SecondaryIndex::Clear() {
+	funds.clear();
+	amounts.clear();
+	entries.clear();
+}
+
+/**
+ * Get the handles of the bids in a fund, in no particular order.
+ * @param fund: The code of the fund to look up.
+ * @return The postings list, or null if no bid is in the fund.
+ */
+const std::vector<uint32_t>* SecondaryIndex::Fund(uint32_t fund) const {
+	if (fund >= funds.size() || funds[fund].empty()) {
+		return nullptr;
+	}
+
+	return &funds[fund];
+}
+
+/**
+ * Get the handles of the bids with an amount in a range, in order of amount.
+ * @param lo: The smallest amount to include.
+ * @param hi: The largest amount to include.
+ * @param handles: Receives the handles.
+ */
+void SecondaryIndex::AmountRange(double lo, double hi, std::vector<uint32_t>* handles) const {
+	handles->clear();
+
+	if (!(lo <= hi)) {
+		return;
+	}
+
+	AmountMap::const_iterator end = amounts.upper_bound(hi);
+
+	for (AmountMap::const_iterator it = amounts.lower_bound(lo); it != end; ++it) {
+		handles->push_back(it->second);
+	}
+}
+
+/**
+ * Estimate the heap memory held by the indexes.
+ * @return An approximate number of bytes.
+ */
+size_t SecondaryIndex::MemoryUsage() const {
+	// Tree nodes carry a few pointers of bookkeeping each.
+	size_t bytes = entries.capacity() * sizeof(Entry)
+		+ amounts.size() * (sizeof(AmountMap::value_type) + 4 * sizeof(void*))
+		+ funds.capacity() * sizeof(std::vector<uint32_t>);
+
+	for (size_t i = 0; i < funds.size(); i++) {
+		bytes += funds[i].capacity() * sizeof(uint32_t);
+	}
+
+	return bytes;
+}
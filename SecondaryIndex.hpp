@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * Define indexes over the fund and amount of each bid, addressed by bid
+ * handle. Each fund code has a postings list of handles, and amounts are kept
+ * in an ordered multimap. Each handle remembers where its entries are, so a bid
+ * is added or removed in constant time for the fund and logarithmic time for
+ * the amount.
+ */
+class SecondaryIndex {
+
+private:
+	static const uint32_t NOT_INDEXED = 0xFFFFFFFF;
+
+	typedef std::multimap<double, uint32_t> AmountMap;
+
+	// Where a handle's entries live, so they can be removed without searching.
+	struct Entry {
+		uint32_t fund;
+		uint32_t position;
+		AmountMap::iterator amount;
+	};
+
+	std::vector<std::vector<uint32_t> > funds; // by fund code
+	AmountMap amounts;
+	std::vector<Entry> entries; // by handle; fund is NOT_INDEXED for handles not in the index
+
+public:
+	void Add(uint32_t handle, uint32_t fund, double amount);
+	void Remove(uint32_t handle);
+	void Clear();
+	const std::vector<uint32_t>* Fund(uint32_t fund) const;
+	void AmountRange(double lo, double hi, std::vector<uint32_t>* handles) const;
+	size_t MemoryUsage() const;
+};
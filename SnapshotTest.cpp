@@ -0,0 +1,286 @@
+/**
+ * Regression checks for tree snapshots: path copying, the splice-based
+ * removes and epoch reclamation. Built as its own program next to the app.
+ *
+ * The first check applies random changes to a tree and to a std::map kept
+ * alongside it, holding snapshots across the changes and comparing each one
+ * with a copy of the map taken with it. The second runs a writer thread
+ * against reader threads that walk snapshots; build it with
+ * -fsanitize=thread to have data races reported as well.
+ *
+ * Returns 0 if every check passed.
+ */
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "BinarySearchTree.hpp"
+#include "TreeSnapshot.hpp"
+
+namespace
+{
+	typedef std::map<uint32_t, double> Expected;
+
+	std::atomic<int> failures(0);
+
+	/**
+	 * Record a failed check
+	 *
+	 * @param passed: The result of the check.
+	 * @param what: Describes the check, printed if it failed.
+	 */
+	void expect(bool passed, const std::string& what)
+	{
+		if (!passed) {
+			if (failures++ < 20) {
+				std::cerr << "FAILED: " << what << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * Make the bid stored under a key. The title is derived from the id, so
+	 * readers can tell a torn bid from a whole one.
+	 */
+	Bid makeBid(uint32_t key, double amount)
+	{
+		Bid bid;
+
+		bid.bidId = std::to_string(key);
+		bid.title = "t" + bid.bidId;
+		bid.fund = "f";
+		bid.amount = amount;
+
+		return bid;
+	}
+
+	/**
+	 * Walk a snapshot in order and compare it with the bids it should hold
+	 *
+	 * @param snapshot: The snapshot to walk.
+	 * @param expected: The id and amount of each bid it should hold.
+	 * @param what: Names the snapshot in failure messages.
+	 */
+	void checkSnapshot(TreeSnapshot& snapshot, const Expected& expected, const std::string& what)
+	{
+		std::vector<Bid> batch;
+		Expected::const_iterator it = expected.begin();
+		bool matches = true;
+
+		snapshot.Rewind();
+
+		while (matches && snapshot.NextBatch(&batch)) {
+			for (size_t i = 0; matches && i < batch.size(); i++) {
+				matches = it != expected.end()
+					&& batch[i].bidId == std::to_string(it->first)
+					&& batch[i].amount == it->second
+					&& batch[i].title == "t" + batch[i].bidId;
+				++it;
+			}
+		}
+
+		expect(matches && it == expected.end(), what + " holds the bids it was taken with");
+	}
+
+	/**
+	 * Apply random changes to a tree while holding snapshots of it
+	 *
+	 * @param seed: Seeds the random changes, so a failure can be repeated.
+	 */
+	void randomChanges(unsigned seed)
+	{
+		const uint32_t KEYS = 300;
+		const int CHANGES = 3000;
+		const size_t MAX_SNAPSHOTS = 6;
+
+		std::mt19937 rng(seed);
+		BinarySearchTree tree;
+		Expected expected;
+		std::vector<std::pair<std::shared_ptr<TreeSnapshot>, Expected> > snapshots;
+
+		for (int i = 0; i < CHANGES; i++) {
+			uint32_t key = rng() % KEYS;
+			std::string bidId = std::to_string(key);
+
+			switch (rng() % 10) {
+			case 0:
+			case 1:
+			case 2:
+				if (expected.count(key) == 0) {
+					tree.Insert(makeBid(key, key * 1.5 + i));
+					expected[key] = key * 1.5 + i;
+				}
+				break;
+
+			case 3: {
+				StoreResult result = tree.Upsert(makeBid(key, key * 3.0 + i));
+
+				expect(result == (expected.count(key) ? BID_REPLACED : BID_INSERTED), "Upsert reports whether it replaced a bid");
+				expected[key] = key * 3.0 + i;
+				break;
+			}
+
+			case 4:
+			case 5:
+				tree.Remove(bidId);
+				expected.erase(key);
+				break;
+
+			case 6: {
+				uint32_t hi = key + rng() % 40;
+				int count = 0;
+
+				for (Expected::iterator it = expected.lower_bound(key); it != expected.end() && it->first <= hi; count++) {
+					it = expected.erase(it);
+				}
+
+				expect(tree.RemoveRange(bidId, std::to_string(hi)) == count, "RemoveRange counts the bids it removes");
+				break;
+			}
+
+			case 7: {
+				uint32_t modulus = 2 + rng() % 30;
+				int count = 0;
+
+				for (Expected::iterator it = expected.begin(); it != expected.end();) {
+					if (it->first % modulus == 0) {
+						it = expected.erase(it);
+						count++;
+					}
+					else {
+						++it;
+					}
+				}
+
+				int removed = tree.RemoveIf([modulus](const BidStore& bids, uint32_t handle) {
+					return bids.Key(handle) % modulus == 0;
+				});
+				expect(removed == count, "RemoveIf counts the bids it removes");
+				break;
+			}
+
+			case 8:
+				if (snapshots.size() < MAX_SNAPSHOTS) {
+					snapshots.push_back(std::make_pair(tree.Snapshot(), expected));
+				}
+				else {
+					// Dropping a snapshot lets the tree reclaim what only it could see.
+					snapshots.erase(snapshots.begin() + rng() % snapshots.size());
+				}
+				break;
+
+			default: {
+				Bid found = tree.Search(bidId);
+				expect(expected.count(key) ? found.amount == expected[key] : found.bidId.empty(), "Search sees the latest change");
+
+				for (size_t s = 0; s < snapshots.size(); s++) {
+					Expected& old = snapshots[s].second;
+					found = snapshots[s].first->Search(bidId);
+					expect(old.count(key) ? found.amount == old[key] : found.bidId.empty(), "Snapshot Search sees the tree as it was");
+				}
+				break;
+			}
+			}
+
+			if (i % 200 == 0) {
+				for (size_t s = 0; s < snapshots.size(); s++) {
+					checkSnapshot(*snapshots[s].first, snapshots[s].second, "A held snapshot");
+				}
+			}
+		}
+
+		for (size_t s = 0; s < snapshots.size(); s++) {
+			checkSnapshot(*snapshots[s].first, snapshots[s].second, "A held snapshot");
+		}
+
+		expect(tree.Size() == (int)expected.size(), "Size matches the bids stored");
+		checkSnapshot(*tree.Snapshot(), expected, "A fresh snapshot");
+	}
+
+	/**
+	 * Change a tree on this thread while other threads walk snapshots of it.
+	 * Each walk must come out in id order with every bid whole, and walking
+	 * the same snapshot twice must give the same bids.
+	 *
+	 * @param readers: The number of reader threads.
+	 * @param changes: The number of inserts and removes the writer makes.
+	 */
+	void writerAndReaders(int readers, int changes)
+	{
+		BinarySearchTree tree;
+		std::atomic<bool> done(false);
+		std::vector<std::thread> threads;
+
+		for (int r = 0; r < readers; r++) {
+			threads.push_back(std::thread([&tree, &done]() {
+				while (!done.load()) {
+					std::shared_ptr<TreeSnapshot> snapshot = tree.Snapshot();
+					std::vector<Bid> batch;
+					std::vector<std::string> first;
+					std::vector<std::string> second;
+					bool ordered = true;
+
+					for (int pass = 0; pass < 2; pass++) {
+						std::vector<std::string>& ids = (pass == 0) ? first : second;
+						uint64_t last = 0;
+
+						snapshot->Rewind();
+						while (snapshot->NextBatch(&batch)) {
+							for (size_t i = 0; i < batch.size(); i++) {
+								uint64_t key = std::stoull(batch[i].bidId);
+
+								ordered = ordered && (ids.empty() || key > last) && batch[i].title == "t" + batch[i].bidId;
+								last = key;
+								ids.push_back(batch[i].bidId);
+							}
+						}
+					}
+
+					expect(ordered, "A snapshot walk is in id order with whole bids");
+					expect(first == second, "A snapshot gives the same bids on every walk");
+				}
+			}));
+		}
+
+		std::mt19937 rng(11);
+
+		for (int i = 0; i < changes; i++) {
+			uint32_t key = rng() % 100000;
+
+			if (rng() % 4 != 0) {
+				tree.Upsert(makeBid(key, key));
+			}
+			else {
+				tree.Remove(std::to_string(key));
+			}
+		}
+
+		done.store(true);
+
+		for (size_t r = 0; r < threads.size(); r++) {
+			threads[r].join();
+		}
+	}
+}
+
+int main()
+{
+	for (unsigned seed = 1; seed <= 40; seed++) {
+		randomChanges(seed);
+	}
+
+	writerAndReaders(2, 100000);
+
+	if (failures > 0) {
+		std::cout << failures << " checks failed." << std::endl;
+		return 1;
+	}
+
+	std::cout << "All snapshot checks passed." << std::endl;
+	return 0;
+}
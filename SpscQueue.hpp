@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Define a bounded, lock-free queue for exactly one producer thread and one
+ * consumer thread. A full queue makes the producer wait, which holds back a
+ * fast stage until the stage after it catches up.
+ *
+ * A waiting thread yields for a short while and then sleeps, for longer each
+ * time up to a millisecond, so stages held back by a slower one don't keep a
+ * processor busy for the whole load.
+ */
+template <typename T>
+class SpscQueue {
+
+private:
+	std::vector<T> slots;
+	size_t mask;
+	char padding0[64];
+	std::atomic<size_t> head; // next slot to pop, written by the consumer
+	char padding1[64];
+	std::atomic<size_t> tail; // next slot to push, written by the producer
+	char padding2[64];
+	std::atomic<bool> closed;
+
+	/**
+	 * Wait before trying again.
+	 * @param attempt: The number of waits so far, kept by the caller from zero.
+	 */
+	static void backOff(unsigned* attempt) {
+		const unsigned SPIN_LIMIT = 64;
+		const unsigned MAX_SLEEP_MICROSECONDS = 1000;
+
+		if (*attempt < SPIN_LIMIT) {
+			++*attempt;
+			std::this_thread::yield();
+			return;
+		}
+
+		// Sleep 50us after the spin, doubling with each wait.
+		unsigned shift = std::min(*attempt - SPIN_LIMIT, 5u);
+		unsigned micros = std::min(50u << shift, MAX_SLEEP_MICROSECONDS);
+
+		++*attempt;
+		std::this_thread::sleep_for(std::chrono::microseconds(micros));
+	}
+
+public:
+	/**
+	 * Constructor
+	 * @param capacity: The number of items the queue can hold, rounded up to a power of two.
+	 */
+	explicit SpscQueue(size_t capacity) : head(0), tail(0), closed(false) {
+		size_t size = 1;
+
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		slots.resize(size);
+		mask = size - 1;
+	}
+
+	/**
+	 * Push an item if there is room for it.
+	 * @param value: The item, which is moved from only if the push succeeds.
+	 * @return True if the item was pushed.
+	 */
+	bool TryPush(T& value) {
+		size_t curTail = tail.load(std::memory_order_relaxed);
+
+		if (curTail - head.load(std::memory_order_acquire) == slots.size()) {
+			return false;
+		}
+
+		slots[curTail & mask] = std::move(value);
+		tail.store(curTail + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/**
+	 * Pop an item if one is waiting.
+	 * @param value: Receives the item.
+	 * @return True if an item was popped.
+	 */
+	bool TryPop(T* value) {
+		size_t curHead = head.load(std::memory_order_relaxed);
+
+		if (curHead == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		*value = std::move(slots[curHead & mask]);
+		head.store(curHead + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	/**
+	 * Push an item, waiting for room.
+	 * @param value: The item to push.
+	 * @param cancelled: Stops the wait when it becomes true.
+	 * @return True if the item was pushed, false if the wait was cancelled.
+	 */
+	bool Push(T& value, const std::atomic<bool>& cancelled) {
+		unsigned attempt = 0;
+
+		while (!TryPush(value)) {
+			if (cancelled.load(std::memory_order_relaxed)) {
+				return false;
+			}
+			backOff(&attempt);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Pop an item, waiting for one to arrive.
+	 * @param value: Receives the item.
+	 * @param cancelled: Stops the wait when it becomes true.
+	 * @return True if an item was popped, false if the queue is closed and empty or the wait was cancelled.
+	 */
+	bool Pop(T* value, const std::atomic<bool>& cancelled) {
+		unsigned attempt = 0;
+
+		while (!TryPop(value)) {
+			if (cancelled.load(std::memory_order_relaxed)) {
+				return false;
+			}
+			// Check once more after seeing the close, in case the last items arrived just before it.
+			if (closed.load(std::memory_order_acquire)) {
+				return TryPop(value);
+			}
+			backOff(&attempt);
+		}
+
+		return true;
+	}
+
+	/**
+	 * Mark the end of the stream. Called by the producer after its last push.
+	 */
+	void Close() {
+		closed.store(true, std::memory_order_release);
+	}
+};
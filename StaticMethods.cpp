@@ -1,6 +1,12 @@
 #include "StaticMethods.hpp"
 #include <iostream>
-#include "CSVparser/CSVparser.hpp"
+#include <algorithm>
+#include <ctime>
+#include <exception>
+#include <memory>
+#include <thread>
+#include "LoadPipeline.hpp"
+#include "RequestServer.hpp"
 
 /**
  * Simple C function to convert a string to a double
@@ -17,6 +23,90 @@ double BST::strToDouble(std::string str, char ch)
 	return atof(str.c_str());
 }
 
+/**
+ * Convert a month/day/year date, such as the CloseDate column's "12/1/16", to
+ * a day count. Two-digit years are taken to be in the 2000s.
+ *
+ * @param str: The date to convert
+ * @return The number of days since 1/1/1970, or NO_DATE if str is not a valid date.
+ */
+int32_t BST::parseDate(std::string str)
+{
+	int parts[3] = { 0, 0, 0 };
+	int digits[3] = { 0, 0, 0 };
+	int part = 0;
+
+	size_t begin = str.find_first_not_of(" \t");
+	size_t end = str.find_last_not_of(" \t");
+
+	if (begin == std::string::npos) {
+		return NO_DATE;
+	}
+
+	for (size_t i = begin; i <= end; i++) {
+		if (str[i] >= '0' && str[i] <= '9' && digits[part] < 4) {
+			parts[part] = parts[part] * 10 + (str[i] - '0');
+			++digits[part];
+		}
+		else if (str[i] == '/' && part < 2 && digits[part] > 0) {
+			++part;
+		}
+		else {
+			return NO_DATE;
+		}
+	}
+
+	if (part != 2 || digits[2] == 0) {
+		return NO_DATE;
+	}
+
+	int month = parts[0];
+	int day = parts[1];
+	int year = digits[2] <= 2 ? 2000 + parts[2] : parts[2];
+
+	static const int monthDays[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+	if (month < 1 || month > 12 || day < 1 || day > monthDays[month - 1] || (month == 2 && day == 29 && !leap)) {
+		return NO_DATE;
+	}
+
+	// Count days in a calendar that starts in March, so the leap day falls at the end of the year.
+	int shifted = month <= 2 ? year - 1 : year;
+	int era = shifted / 400;
+	int yearOfEra = shifted - era * 400;
+	int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+	int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * Convert a day count back to a month/day/year date.
+ *
+ * @param date: The number of days since 1/1/1970
+ * @return The date as "M/D/YYYY", or an empty string for NO_DATE.
+ */
+std::string BST::formatDate(int32_t date)
+{
+	if (date == NO_DATE) {
+		return "";
+	}
+
+	// The inverse of parseDate, again in a calendar starting in March.
+	int days = date + 719468;
+	int era = (days >= 0 ? days : days - 146096) / 146097;
+	int dayOfEra = days - era * 146097;
+	int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int shiftedMonth = (5 * dayOfYear + 2) / 153;
+	int day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+	int month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+	int year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+	return std::to_string(month) + "/" + std::to_string(day) + "/" + std::to_string(year);
+}
+
 //============================================================================
 // Static methods used for testing
 //============================================================================
@@ -33,46 +123,259 @@ void BST::displayBid(Bid bid)
 	return;
 }
 
+namespace
+{
+	/**
+	 * Warn about the rows a load skipped because their bid id can't be a key
+	 *
+	 * @param csvPath: The file that was loaded.
+	 * @param pipeline: The pipeline that loaded it.
+	 */
+	void reportRejected(const std::string& csvPath, const LoadPipeline& pipeline)
+	{
+		if (pipeline.Rejected() > 0) {
+			std::cerr << csvPath << ": skipped " << pipeline.Rejected()
+				<< " rows with a bid id that is not a 32-bit number without leading zeros (first: \""
+				<< pipeline.FirstRejected() << "\")" << std::endl;
+		}
+	}
+}
+
 /**
- * Load a CSV file containing bids into a container
+ * Load a CSV file containing bids into a container. Bids already in the
+ * container are replaced, not duplicated. Rows whose bid id can't be a key
+ * are skipped and reported on stderr.
  *
  * @param csvPath: The path to the CSV file to load
- * @return A container holding all the bids read
+ * @param bst: The tree to store the bids in
+ * @param offset: The offset returned by the last load of this file, to read
+ *                only the rows appended since, or 0 to read the whole file
+ * @return The offset to pass to the next load of this file
+ * @throws csv::Error if the file can't be read or a row is malformed
  */
-void BST::loadBids(std::string csvPath, BinarySearchTree* bst) 
+std::streamoff BST::loadBids(std::string csvPath, BinarySearchTree* bst, std::streamoff offset)
 {
 	std::cout << "Loading CSV file " << csvPath << std::endl;
 
-	// initialize the CSV Parser using the given path
-	csv::Parser file = csv::Parser(csvPath);
+	// Read, tokenize, convert and store on separate threads.
+	LoadPipeline pipeline(csvPath, offset);
+	std::streamoff end = pipeline.Run(bst);
+
+	reportRejected(csvPath, pipeline);
 
-	// read and display header row - optional
-	/*
-	vector<string> header = file.getHeader();
-	for (auto const& c : header) {
-		cout << c << " | ";
+	return end;
+}
+
+/**
+ * Load several CSV files at once, each into its own tree on its own thread,
+ * then merge the trees into bst in the order the files are listed. Each merge
+ * copies a tree's arrays whole; files covering separate id ranges, such as one
+ * file per month, are then joined without walking their bids. Where files
+ * share an id, the later file's bid wins.
+ *
+ * @param csvPaths: The paths to the CSV files.
+ * @param bst: The tree to merge the bids into.
+ */
+void BST::loadBidFiles(const std::vector<std::string>& csvPaths, BinarySearchTree* bst)
+{
+	std::vector<std::unique_ptr<BinarySearchTree> > trees;
+	std::vector<std::unique_ptr<LoadPipeline> > pipelines;
+	std::vector<std::exception_ptr> errors(csvPaths.size());
+	std::vector<std::thread> loaders;
+
+	for (size_t i = 0; i < csvPaths.size(); i++) {
+		std::cout << "Loading CSV file " << csvPaths[i] << std::endl;
+		trees.push_back(std::unique_ptr<BinarySearchTree>(new BinarySearchTree()));
+		pipelines.push_back(std::unique_ptr<LoadPipeline>(new LoadPipeline(csvPaths[i])));
 	}
-	cout << "" << endl;
-	*/
 
-	try {
-		// loop to read rows of a CSV file
-		for (unsigned int i = 0; i < file.rowCount(); i++) {
+	for (size_t i = 0; i < csvPaths.size(); i++) {
+		loaders.push_back(std::thread([&, i]() {
+			try {
+				pipelines[i]->Run(trees[i].get());
+			}
+			catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}));
+	}
+
+	for (size_t i = 0; i < loaders.size(); i++) {
+		loaders[i].join();
+	}
+
+	// Keep whatever loaded, as loadBids does, then report the first failure.
+	for (size_t i = 0; i < trees.size(); i++) {
+		reportRejected(csvPaths[i], *pipelines[i]);
+		bst->Merge(trees[i].get());
+		trees[i].reset();
+	}
+
+	for (size_t i = 0; i < errors.size(); i++) {
+		if (errors[i]) {
+			std::rethrow_exception(errors[i]);
+		}
+	}
+}
+
+namespace
+{
+	/**
+	 * Time a loop of Search calls and print the result
+	 *
+	 * @param bst: The tree to search.
+	 * @param label: The name to print for the run.
+	 * @param queries: The ids to look up.
+	 */
+	void timeSearch(BinarySearchTree* bst, const char* label, const std::vector<std::string>& queries)
+	{
+		size_t found = 0;
+		clock_t ticks = clock();
+
+		for (size_t i = 0; i < queries.size(); i++) {
+			if (!bst->Search(queries[i]).bidId.empty()) {
+				++found;
+			}
+		}
+
+		ticks = clock() - ticks;
+		double seconds = ticks * 1.0 / CLOCKS_PER_SEC;
+		std::cout << label << found << " found, " << seconds << " seconds, "
+			<< seconds * 1e9 / queries.size() << " ns each" << std::endl;
+	}
+
+	/**
+	 * Time SearchBatch over the same ids and print the result
+	 *
+	 * @param bst: The tree to search.
+	 * @param label: The name to print for the run.
+	 * @param queries: The ids to look up.
+	 */
+	void timeSearchBatch(BinarySearchTree* bst, const char* label, const std::vector<std::string>& queries)
+	{
+		const size_t BATCH_SIZE = 256;
+
+		std::vector<std::string> batch;
+		std::vector<uint32_t> handles;
+		size_t found = 0;
+		clock_t ticks = clock();
 
-			// Create a data structure and add to the collection of bids
-			Bid bid;
-			bid.bidId = file[i][1];
-			bid.title = file[i][0];
-			bid.fund = file[i][8];
-			bid.amount = strToDouble(file[i][4], '$');
+		for (size_t start = 0; start < queries.size(); start += BATCH_SIZE) {
+			size_t end = std::min(queries.size(), start + BATCH_SIZE);
 
-			//cout << "Item: " << bid.title << ", Fund: " << bid.fund << ", Amount: " << bid.amount << endl;
+			batch.assign(queries.begin() + start, queries.begin() + end);
+			bst->SearchBatch(batch, &handles);
 
-			// push this bid to the end
-			bst->Insert(bid);
+			for (size_t i = 0; i < handles.size(); i++) {
+				if (handles[i] != NIL_INDEX) {
+					++found;
+				}
+			}
 		}
+
+		ticks = clock() - ticks;
+		double seconds = ticks * 1.0 / CLOCKS_PER_SEC;
+		std::cout << label << found << " found, " << seconds << " seconds, "
+			<< seconds * 1e9 / queries.size() << " ns each" << std::endl;
+	}
+}
+
+/**
+ * Time lookups of present and absent ids through the tree, then through the
+ * hash index, and report the memory the hash index takes
+ *
+ * @param bst: The tree to search.
+ * @param lookups: The number of lookups to run with each method.
+ */
+void BST::benchmarkLookups(BinarySearchTree* bst, unsigned int lookups)
+{
+	std::vector<std::string> bidIds = bst->BidIds();
+
+	if (bidIds.empty()) {
+		std::cout << "No bids loaded." << std::endl;
+		return;
+	}
+
+	// Visit the ids in a scrambled order so consecutive lookups don't share a path.
+	std::vector<std::string> hits;
+	std::vector<std::string> misses;
+	hits.reserve(lookups);
+	misses.reserve(lookups);
+	for (unsigned int i = 0; i < lookups; i++) {
+		hits.push_back(bidIds[(i * 2654435761u) % bidIds.size()]);
+
+		// Shifting an id far along the key space almost never lands on another id.
+		uint32_t key = 0;
+		BidStore::ParseKey(hits.back(), &key);
+		misses.push_back(std::to_string(key + 0x9E3779B9u));
 	}
-	catch (csv::Error& e) {
+
+	bool hashed = bst->HasHashIndex();
+	if (hashed) {
+		bst->DropHashIndex();
+	}
+
+	timeSearch(bst, "Tree Search hits:          ", hits);
+	timeSearch(bst, "Tree Search misses:        ", misses);
+	timeSearchBatch(bst, "Tree SearchBatch hits:     ", hits);
+	timeSearchBatch(bst, "Tree SearchBatch misses:   ", misses);
+
+	size_t before = bst->MemoryUsage();
+	bst->BuildHashIndex();
+	std::cout << "Hash index (" << HashIndex::Implementation() << "): "
+		<< bst->MemoryUsage() - before << " bytes for " << bidIds.size() << " ids" << std::endl;
+
+	timeSearch(bst, "Hash Search hits:          ", hits);
+	timeSearch(bst, "Hash Search misses:        ", misses);
+	timeSearchBatch(bst, "Hash SearchBatch hits:     ", hits);
+	timeSearchBatch(bst, "Hash SearchBatch misses:   ", misses);
+
+	if (!hashed) {
+		bst->DropHashIndex();
+	}
+}
+
+/**
+ * Load the bids once and answer requests until the input ends, instead of
+ * showing the menu. Status goes to stderr, since stdout may carry responses.
+ *
+ * @param bst: The tree to load into
+ * @param csvPath: The file to load
+ * @param socketPath: The Unix-domain socket to listen on, or empty to read requests from stdin
+ * @return The process exit code
+ */
+int BST::serveBids(BinarySearchTree* bst, std::string csvPath, std::string socketPath)
+{
+	try {
+		LoadPipeline pipeline(csvPath);
+		pipeline.Run(bst);
+		reportRejected(csvPath, pipeline);
+	}
+	catch (std::exception& e) {
 		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	// Point lookups dominate, so make each one a single probe.
+	bst->BuildHashIndex();
+	std::cerr << bst->Size() << " bids loaded from " << csvPath << std::endl;
+
+	RequestServer server(bst);
+
+	if (socketPath.empty()) {
+		// Unsynchronized streams buffer waiting input, which lets pipelined requests batch up.
+		std::ios::sync_with_stdio(false);
+		server.Serve(std::cin, std::cout);
+	}
+	else {
+		std::cerr << "Listening on " << socketPath << std::endl;
+		if (!server.ServeSocket(socketPath)) {
+			return 1;
+		}
 	}
-}
\ No newline at end of file
+
+	std::cerr << server.Served() << " requests handled in " << server.Seconds() << " seconds ("
+		<< server.QueriesPerSecond() << " queries per second)" << std::endl;
+
+	return 0;
+}
@@ -1,11 +1,18 @@
 #pragma once
 #include <string>
+#include <ios>
+#include <vector>
 #include "BinarySearchTree.hpp"
 
 namespace BST
 {
 	double strToDouble(std::string str, char ch);
+	int32_t parseDate(std::string str);
+	std::string formatDate(int32_t date);
 	void displayBid(Bid bid);
-	void loadBids(std::string csvPath, BinarySearchTree* bst);
+	std::streamoff loadBids(std::string csvPath, BinarySearchTree* bst, std::streamoff offset = 0);
+	void loadBidFiles(const std::vector<std::string>& csvPaths, BinarySearchTree* bst);
+	void benchmarkLookups(BinarySearchTree* bst, unsigned int lookups);
+	int serveBids(BinarySearchTree* bst, std::string csvPath, std::string socketPath);
 }
 
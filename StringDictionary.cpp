@@ -0,0 +1,75 @@
+#include "StringDictionary.hpp"
+#include <algorithm>
+
+/**
+ * Get the code for a string, adding the string if it is new.
+ * @param value: The string to intern.
+ * @return The string's code.
+ */
+uint32_t StringDictionary::Intern(const std::string& value) {
+	std::unordered_map<std::string, uint32_t>::const_iterator found = codes.find(value);
+
+	if (found != codes.end()) {
+		return found->second;
+	}
+
+	uint32_t code = (uint32_t)values.size();
+
+	values.push_back(value);
+	codes.insert(std::make_pair(value, code));
+
+	return code;
+}
+
+/**
+ * Look up the code for a string without adding it.
+ * @param value: The string to look up.
+ * @param code: Receives the code.
+ * @return True if the string has been interned.
+ */
+bool StringDictionary::Find(const std::string& value, uint32_t* code) const {
+	std::unordered_map<std::string, uint32_t>::const_iterator found = codes.find(value);
+
+	if (found == codes.end()) {
+		return false;
+	}
+
+	*code = found->second;
+	return true;
+}
+
+/**
+ * Check whether interning some new strings would move the existing ones.
+ * @param newValues: The number of strings not yet in the dictionary.
+ * @return True if Reserve must be called first.
+ */
+bool StringDictionary::NeedsGrowth(size_t newValues) const {
+	return values.size() + newValues > values.capacity();
+}
+
+/**
+ * Make room for some new strings, doubling so growth happens rarely.
+ * @param newValues: The number of strings about to be interned.
+ */
+void StringDictionary::Reserve(size_t newValues) {
+	size_t needed = values.size() + newValues;
+
+	if (needed > values.capacity()) {
+		values.reserve(std::max<size_t>(std::max<size_t>(16, needed), values.capacity() * 2));
+	}
+}
+
+/**
+ * Estimate the heap memory held by the dictionary.
+ * @return An approximate number of bytes.
+ */
+size_t StringDictionary::MemoryUsage() const {
+	size_t bytes = values.capacity() * sizeof(std::string) + codes.bucket_count() * sizeof(void*);
+
+	// Each string is held twice, once in the list and once as a hash key.
+	for (size_t i = 0; i < values.size(); i++) {
+		bytes += 2 * values[i].capacity() + sizeof(std::pair<const std::string, uint32_t>) + sizeof(void*);
+	}
+
+	return bytes;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Define a dictionary that interns strings as small integer codes. Columns
+ * with few distinct values store a code per row, and comparing two codes is
+ * the same as comparing the strings. Like BidStore, interning a new value only
+ * moves existing values when NeedsGrowth says so, so readers on other threads
+ * can keep looking codes up meanwhile.
+ */
+class StringDictionary {
+
+private:
+	std::vector<std::string> values;
+	std::unordered_map<std::string, uint32_t> codes;
+
+public:
+	uint32_t Intern(const std::string& value);
+	bool Find(const std::string& value, uint32_t* code) const;
+	const std::string& Value(uint32_t code) const { return values[code]; }
+	bool NeedsGrowth(size_t newValues) const;
+	void Reserve(size_t newValues);
+	size_t Size() const { return values.size(); }
+	size_t MemoryUsage() const;
+};
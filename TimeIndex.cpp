@@ -0,0 +1,213 @@
+#include "TimeIndex.hpp"
+#include "Bid.hpp"
+#include <algorithm>
+
+/**
+ * Add a bid to the index. Bids without a close date are left out.
+ * @param handle: The handle of the bid.
+ * @param date: The bid's close date in days since 1/1/1970.
+ * @param amount: The bid's amount.
+ */
+void TimeIndex::Add(uint32_t handle, int32_t date, double amount) {
+	if (handle >= entries.size()) {
+		Entry empty = { NO_DATE, 0, 0.0 };
+		entries.resize(handle + 1, empty);
+	}
+	else if (entries[handle].date != NO_DATE) {
+		Remove(handle);
+	}
+
+	if (date == NO_DATE) {
+		return;
+	}
+
+	Day& day = days[date];
+	Rollup& week = weeks[WeekStart(date)];
+
+	entries[handle].date = date;
+	entries[handle].position = (uint32_t)day.handles.size();
+	entries[handle].amount = amount;
+	day.handles.push_back(handle);
+	day.amount += amount;
+
+	week.date = WeekStart(date);
+	++week.count;
+	week.amount += amount;
+}
+
+/**
+ * Take a bid out of its day and week. Nothing happens for a handle that was
+ * never added or had no close date.
+ * @param handle: The handle of the bid.
+ */
+void TimeIndex::Remove(uint32_t handle) {
+	if (handle >= entries.size() || entries[handle].date == NO_DATE) {
+		return;
+	}
+
+	Entry& entry = entries[handle];
+	std::map<int32_t, Day>::iterator day = days.find(entry.date);
+	std::map<int32_t, Rollup>::iterator week = weeks.find(WeekStart(entry.date));
+
+	// Order within a day doesn't matter, so the day's last bid fills the gap.
+	std::vector<uint32_t>& handles = day->second.handles;
+	uint32_t last = handles.back();
+	handles[entry.position] = last;
+	entries[last].position = entry.position;
+	handles.pop_back();
+
+	// Drop empty buckets, which also clears any rounding left in their amounts.
+	if (handles.empty()) {
+		days.erase(day);
+	}
+	else {
+		day->second.amount -= entry.amount;
+	}
+
+	if (--week->second.count == 0) {
+		weeks.erase(week);
+	}
+	else {
+		week->second.amount -= entry.amount;
+	}
+
+	entry.date = NO_DATE;
+}
+
+/**
+ * Add every bid of another index at once, a day at a time, for bids whose
+ * handles moved up by an offset when their store was appended to this one.
+ * @param other: The index to copy from.
+ * @param offset: The amount added to each of the other index's handles.
+ */
+void TimeIndex::Absorb(const TimeIndex& other, uint32_t offset) {
+	if (other.entries.empty()) {
+		return;
+	}
+
+	Entry empty = { NO_DATE, 0, 0.0 };
+	entries.resize(std::max(entries.size(), offset + other.entries.size()), empty);
+
+	for (std::map<int32_t, Day>::const_iterator it = other.days.begin(); it != other.days.end(); ++it) {
+		Day& day = days[it->first];
+		const std::vector<uint32_t>& handles = it->second.handles;
+
+		for (size_t i = 0; i < handles.size(); i++) {
+			Entry& entry = entries[handles[i] + offset];
+
+			entry = other.entries[handles[i]];
+			entry.position = (uint32_t)day.handles.size();
+			day.handles.push_back(handles[i] + offset);
+		}
+
+		day.amount += it->second.amount;
+	}
+
+	for (std::map<int32_t, Rollup>::const_iterator it = other.weeks.begin(); it != other.weeks.end(); ++it) {
+		Rollup& week = weeks[it->first];
+
+		week.date = it->first;
+		week.count += it->second.count;
+		week.amount += it->second.amount;
+	}
+}
+
+/**
+ * Remove every bid from the index.
+ */
+void TimeIndex::Clear() {
+	days.clear();
+	weeks.clear();
+	entries.clear();
+}
+
+/**
+ * Get the handles of the bids that closed in a range of days, in date order.
+ * @param from: The first day of the range.
+ * @param to: The last day of the range.
+ * @param handles: Receives the handles.
+ */
+void TimeIndex::Between(int32_t from, int32_t to, std::vector<uint32_t>* handles) const {
+	handles->clear();
+
+	if (from > to) {
+		return;
+	}
+
+	std::map<int32_t, Day>::const_iterator end = days.upper_bound(to);
+
+	for (std::map<int32_t, Day>::const_iterator it = days.lower_bound(from); it != end; ++it) {
+		handles->insert(handles->end(), it->second.handles.begin(), it->second.handles.end());
+	}
+}
+
+/**
+ * Get the count and amount of each day in a range that has bids.
+ * @param from: The first day of the range.
+ * @param to: The last day of the range.
+ * @param rollups: Receives one rollup per day, in date order.
+ */
+void TimeIndex::Days(int32_t from, int32_t to, std::vector<Rollup>* rollups) const {
+	rollups->clear();
+
+	if (from > to) {
+		return;
+	}
+
+	std::map<int32_t, Day>::const_iterator end = days.upper_bound(to);
+
+	for (std::map<int32_t, Day>::const_iterator it = days.lower_bound(from); it != end; ++it) {
+		Rollup rollup = { it->first, (uint32_t)it->second.handles.size(), it->second.amount };
+		rollups->push_back(rollup);
+	}
+}
+
+/**
+ * Get the count and amount of each week that overlaps a range and has bids.
+ * Weeks are whole, so the first and last may include days outside the range.
+ * @param from: The first day of the range.
+ * @param to: The last day of the range.
+ * @param rollups: Receives one rollup per week, in date order.
+ */
+void TimeIndex::Weeks(int32_t from, int32_t to, std::vector<Rollup>* rollups) const {
+	rollups->clear();
+
+	if (from > to) {
+		return;
+	}
+
+	std::map<int32_t, Rollup>::const_iterator end = weeks.upper_bound(to);
+
+	for (std::map<int32_t, Rollup>::const_iterator it = weeks.lower_bound(WeekStart(from)); it != end; ++it) {
+		rollups->push_back(it->second);
+	}
+}
+
+/**
+ * Estimate the heap memory held by the index.
+ * @return An approximate number of bytes.
+ */
+size_t TimeIndex::MemoryUsage() const {
+	// Each map node adds its links and colour to the pair it holds; four pointers is close.
+	size_t bytes = entries.capacity() * sizeof(Entry)
+		+ days.size() * (sizeof(std::pair<const int32_t, Day>) + 4 * sizeof(void*))
+		+ weeks.size() * (sizeof(std::pair<const int32_t, Rollup>) + 4 * sizeof(void*));
+
+	for (std::map<int32_t, Day>::const_iterator it = days.begin(); it != days.end(); ++it) {
+		bytes += it->second.handles.capacity() * sizeof(uint32_t);
+	}
+
+	return bytes;
+}
+
+/**
+ * Find the Monday that starts the week holding a day.
+ * @param date: The day, in days since 1/1/1970.
+ * @return The Monday, in days since 1/1/1970.
+ */
+int32_t TimeIndex::WeekStart(int32_t date) {
+	// 1/1/1970 was a Thursday, three days after a Monday.
+	int32_t weekday = ((date + 3) % 7 + 7) % 7;
+
+	return date - weekday;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * Summarize the bids that closed on one day, or in the week starting on it.
+ */
+struct Rollup {
+	int32_t date; // days since 1/1/1970
+	uint32_t count;
+	double amount;
+};
+
+/**
+ * Define an ordered index over the close date of each bid, addressed by bid
+ * handle. Each day holds the handles of the bids that closed on it, and the
+ * count and amount of those bids are kept per day and per week as bids come
+ * and go, so rollups are read rather than recomputed.
+ */
+class TimeIndex {
+
+private:
+	struct Day {
+		double amount;
+		std::vector<uint32_t> handles; // unordered; the bid count is their number
+	};
+
+	// The day a bid was filed under, its slot in that day, and the amount it
+	// added to the day and week totals, which are subtracted again on removal.
+	struct Entry {
+		int32_t date;
+		uint32_t position;
+		double amount;
+	};
+
+	std::map<int32_t, Day> days;
+	std::map<int32_t, Rollup> weeks; // keyed by the Monday each week starts on
+	std::vector<Entry> entries; // by handle; date is NO_DATE for handles not in the index
+
+public:
+	void Add(uint32_t handle, int32_t date, double amount);
+	void Remove(uint32_t handle);
+	void Absorb(const TimeIndex& other, uint32_t offset);
+	void Clear();
+	void Between(int32_t from, int32_t to, std::vector<uint32_t>* handles) const;
+	void Days(int32_t from, int32_t to, std::vector<Rollup>* rollups) const;
+	void Weeks(int32_t from, int32_t to, std::vector<Rollup>* rollups) const;
+	size_t MemoryUsage() const;
+
+	static int32_t WeekStart(int32_t date);
+};
@@ -0,0 +1,360 @@
+#include "TitleIndex.hpp"
+#include <algorithm>
+
+namespace {
+
+	// Flags kept for each handle in TitleIndex::states.
+	const uint8_t INDEXED = 1; // the bid's current title is in the index
+	const uint8_t PENDING = 2; // the handle is in the added list
+	const uint8_t SORTED = 4; // the handle is in the sorted list, where it is stale if PENDING is set or INDEXED is not
+
+	/**
+	 * Fold an ASCII letter to lower case, leaving every other byte alone.
+	 */
+	inline unsigned char foldByte(char c) {
+		unsigned char b = (unsigned char)c;
+
+		return (b >= 'A' && b <= 'Z') ? (unsigned char)(b + 0x20) : b;
+	}
+
+	/**
+	 * Compare two strings as they would compare once folded.
+	 * @return Less than, equal to or greater than zero as the first sorts before, with or after the second.
+	 */
+	int compareFolded(const char* first, size_t firstLength, const char* second, size_t secondLength) {
+		size_t length = std::min(firstLength, secondLength);
+
+		for (size_t i = 0; i < length; i++) {
+			unsigned char a = foldByte(first[i]);
+			unsigned char b = foldByte(second[i]);
+
+			if (a != b) {
+				return (a < b) ? -1 : 1;
+			}
+		}
+
+		return (firstLength < secondLength) ? -1 : (firstLength > secondLength) ? 1 : 0;
+	}
+
+	/**
+	 * Check whether a bid's title contains some text, ignoring case.
+	 * @param folded: The text, already folded.
+	 */
+	bool titleContains(const BidStore& bids, uint32_t handle, const std::string& folded) {
+		const char* title = bids.TitleData(handle);
+		const char* end = title + bids.TitleLength(handle);
+
+		return folded.empty() || std::search(title, end, folded.begin(), folded.end(),
+			[](char a, char b) { return foldByte(a) == (unsigned char)b; }) != end;
+	}
+
+	/**
+	 * Order handles by folded title, then by handle.
+	 */
+	struct TitleOrder {
+		const BidStore* bids;
+
+		bool operator()(uint32_t first, uint32_t second) const {
+			int order = compareFolded(bids->TitleData(first), bids->TitleLength(first), bids->TitleData(second), bids->TitleLength(second));
+
+			return (order != 0) ? order < 0 : first < second;
+		}
+	};
+}
+
+/**
+ * Default constructor
+ */
+TitleIndex::TitleIndex() {
+	removedSorted = 0;
+	livePostings = 0;
+	stalePostings = 0;
+}
+
+/**
+ * Add a bid's title to the index, replacing its old title if it has one.
+ * @param handle: The handle of the bid.
+ * @param bids: The store holding the bid.
+ */
+void TitleIndex::Add(uint32_t handle, const BidStore& bids) {
+	if (handle >= states.size()) {
+		states.resize(handle + 1, 0);
+		trigramCounts.resize(handle + 1, 0);
+	}
+	else if (states[handle] & INDEXED) {
+		Remove(handle);
+	}
+
+	if (!(states[handle] & PENDING)) {
+		added.push_back(handle);
+	}
+	states[handle] |= INDEXED | PENDING;
+
+	post(handle, Fold(bids.Title(handle)));
+
+	if (stalePostings > livePostings + 1024) {
+		compact(bids);
+	}
+}
+
+/**
+ * Remove a bid's title from the index. Handles that are not indexed are ignored.
+ * The bid's title may already have changed.
+ * @param handle: The handle of the bid.
+ */
+void TitleIndex::Remove(uint32_t handle) {
+	if (handle >= states.size() || !(states[handle] & INDEXED)) {
+		return;
+	}
+
+	if ((states[handle] & (SORTED | PENDING)) == SORTED) {
+		++removedSorted;
+	}
+	states[handle] &= ~INDEXED;
+
+	livePostings -= trigramCounts[handle];
+	stalePostings += trigramCounts[handle];
+	trigramCounts[handle] = 0;
+}
+
+/**
+ * Remove every title from the index.
+ */
+void TitleIndex::Clear() {
+	sorted.clear();
+	added.clear();
+	states.clear();
+	trigramCounts.clear();
+	trigrams.clear();
+	removedSorted = 0;
+	livePostings = 0;
+	stalePostings = 0;
+}
+
+/**
+ * Add a handle to the postings list of each trigram in a title.
+ * @param handle: The handle of the bid.
+ * @param folded: The bid's folded title.
+ */
+void TitleIndex::post(uint32_t handle, const std::string& folded) {
+	std::vector<uint32_t> found;
+	trigramsOf(folded, &found);
+
+	for (size_t i = 0; i < found.size(); i++) {
+		trigrams[found[i]].push_back(handle);
+	}
+
+	livePostings += found.size();
+	trigramCounts[handle] = (uint32_t)found.size();
+}
+
+/**
+ * Rebuild the postings lists from the live titles, dropping stale handles.
+ * @param bids: The store holding the bids.
+ */
+void TitleIndex::compact(const BidStore& bids) {
+	trigrams.clear();
+	livePostings = 0;
+	stalePostings = 0;
+
+	for (uint32_t handle = 0; handle < states.size(); handle++) {
+		if (states[handle] & INDEXED) {
+			post(handle, Fold(bids.Title(handle)));
+		}
+	}
+}
+
+/**
+ * Bring the sorted handles up to date: drop the stale ones, then sort the
+ * added handles and merge them in.
+ * @param bids: The store holding the bids.
+ */
+void TitleIndex::merge(const BidStore& bids) {
+	if (added.empty() && removedSorted == 0) {
+		return;
+	}
+
+	// Look at the flags before the added handles clear PENDING.
+	size_t kept = 0;
+
+	for (size_t i = 0; i < sorted.size(); i++) {
+		uint32_t handle = sorted[i];
+
+		if ((states[handle] & (INDEXED | PENDING)) == INDEXED) {
+			sorted[kept++] = handle;
+		}
+		else {
+			states[handle] &= ~SORTED;
+		}
+	}
+	sorted.resize(kept);
+
+	size_t fresh = 0;
+
+	for (size_t i = 0; i < added.size(); i++) {
+		uint32_t handle = added[i];
+
+		states[handle] &= ~PENDING;
+
+		if (states[handle] & INDEXED) {
+			states[handle] |= SORTED;
+			added[fresh++] = handle;
+		}
+	}
+	added.resize(fresh);
+
+	TitleOrder order = { &bids };
+	std::sort(added.begin(), added.end(), order);
+
+	size_t middle = sorted.size();
+	sorted.insert(sorted.end(), added.begin(), added.end());
+	std::inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), order);
+
+	added.clear();
+	removedSorted = 0;
+}
+
+/**
+ * Get the handles of the bids whose titles start with some text, ignoring
+ * case. Merges the changes made since the last lookup first.
+ * @param prefix: The text to look for.
+ * @param bids: The store holding the bids.
+ * @param handles: Receives the handles, in title order.
+ */
+void TitleIndex::Prefix(const std::string& prefix, const BidStore& bids, std::vector<uint32_t>* handles) {
+	std::string folded = Fold(prefix);
+
+	merge(bids);
+	handles->clear();
+
+	// Titles with the prefix sort together, starting where the prefix itself would.
+	std::vector<uint32_t>::const_iterator it = std::lower_bound(sorted.begin(), sorted.end(), folded,
+		[&bids](uint32_t handle, const std::string& text) {
+			return compareFolded(bids.TitleData(handle), bids.TitleLength(handle), text.data(), text.size()) < 0;
+		});
+
+	for (; it != sorted.end(); ++it) {
+		uint32_t length = std::min<uint32_t>(bids.TitleLength(*it), (uint32_t)folded.size());
+
+		if (compareFolded(bids.TitleData(*it), length, folded.data(), folded.size()) != 0) {
+			break;
+		}
+		handles->push_back(*it);
+	}
+}
+
+/**
+ * Get the handles of the bids whose titles contain some text, ignoring case.
+ * @param text: The text to look for.
+ * @param bids: The store holding the bids.
+ * @param handles: Receives the handles, in handle order.
+ */
+void TitleIndex::Substring(const std::string& text, const BidStore& bids, std::vector<uint32_t>* handles) const {
+	std::string folded = Fold(text);
+	std::vector<uint32_t> found;
+
+	handles->clear();
+	trigramsOf(folded, &found);
+
+	// Text too short to have a trigram is checked against every title.
+	if (found.empty()) {
+		for (uint32_t handle = 0; handle < states.size(); handle++) {
+			if ((states[handle] & INDEXED) && titleContains(bids, handle, folded)) {
+				handles->push_back(handle);
+			}
+		}
+	}
+	else {
+		candidates(found, folded, bids, handles);
+	}
+
+	// Both paths give the handles in the same order.
+	std::sort(handles->begin(), handles->end());
+	handles->erase(std::unique(handles->begin(), handles->end()), handles->end());
+}
+
+/**
+ * Get the handles of the titles that contain some text, using the postings
+ * lists of its trigrams.
+ * @param found: The distinct trigrams of the text.
+ * @param folded: The text, already folded.
+ * @param bids: The store holding the bids.
+ * @param handles: Receives the handles, in no particular order and possibly more than once.
+ */
+void TitleIndex::candidates(const std::vector<uint32_t>& found, const std::string& folded, const BidStore& bids, std::vector<uint32_t>* handles) const {
+	// Every match is in each trigram's list, so check the shortest list's titles.
+	const std::vector<uint32_t>* shortest = nullptr;
+
+	for (size_t i = 0; i < found.size(); i++) {
+		std::unordered_map<uint32_t, std::vector<uint32_t> >::const_iterator list = trigrams.find(found[i]);
+
+		if (list == trigrams.end()) {
+			return;
+		}
+		if (shortest == nullptr || list->second.size() < shortest->size()) {
+			shortest = &list->second;
+		}
+	}
+
+	// Stale handles fail the check unless the handle was reused, which can list it twice.
+	for (size_t i = 0; i < shortest->size(); i++) {
+		uint32_t handle = (*shortest)[i];
+
+		if ((states[handle] & INDEXED) && titleContains(bids, handle, folded)) {
+			handles->push_back(handle);
+		}
+	}
+}
+
+/**
+ * Estimate the heap memory held by the index.
+ * @return An approximate number of bytes.
+ */
+size_t TitleIndex::MemoryUsage() const {
+	// Hash nodes carry a couple of pointers of bookkeeping each.
+	size_t bytes = (sorted.capacity() + added.capacity() + trigramCounts.capacity()) * sizeof(uint32_t)
+		+ states.capacity()
+		+ trigrams.bucket_count() * sizeof(void*)
+		+ trigrams.size() * (sizeof(std::pair<const uint32_t, std::vector<uint32_t> >) + 2 * sizeof(void*));
+
+	for (std::unordered_map<uint32_t, std::vector<uint32_t> >::const_iterator it = trigrams.begin(); it != trigrams.end(); ++it) {
+		bytes += it->second.capacity() * sizeof(uint32_t);
+	}
+	return bytes;
+}
+
+/**
+ * Fold the ASCII letters of a string to lower case. Other bytes are left
+ * alone, so multi-byte UTF-8 characters only ever match themselves.
+ * @param text: The string to fold.
+ * @return The folded copy.
+ */
+std::string TitleIndex::Fold(const std::string& text) {
+	std::string folded(text);
+
+	for (size_t i = 0; i < folded.size(); i++) {
+		folded[i] = (char)foldByte(folded[i]);
+	}
+
+	return folded;
+}
+
+/**
+ * Find the distinct trigrams of a folded string.
+ * @param folded: The string, already folded.
+ * @param found: Receives each trigram packed into the low three bytes of an integer.
+ */
+void TitleIndex::trigramsOf(const std::string& folded, std::vector<uint32_t>* found) {
+	found->clear();
+
+	for (size_t i = 0; i + 3 <= folded.size(); i++) {
+		uint32_t trigram = ((uint32_t)(unsigned char)folded[i] << 16)
+			| ((uint32_t)(unsigned char)folded[i + 1] << 8)
+			| (uint32_t)(unsigned char)folded[i + 2];
+
+		found->push_back(trigram);
+	}
+
+	std::sort(found->begin(), found->end());
+	found->erase(std::unique(found->begin(), found->end()), found->end());
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BidStore.hpp"
+
+/**
+ * Define a text index over bid titles, addressed by bid handle. The titles
+ * themselves stay in the bid store; the index keeps the handles sorted by
+ * case-folded title for prefix lookups, and breaks each title into trigrams,
+ * each with a postings list of handles, for substring lookups.
+ *
+ * Added handles wait in a list of their own and removed ones are only
+ * flagged, so loading does not shift the sorted handles once per bid; the
+ * next prefix lookup merges them in. Removed handles likewise stay in the
+ * postings lists, since every candidate is checked against its current title
+ * anyway; the lists are rebuilt once they hold more stale handles than live
+ * ones.
+ */
+class TitleIndex {
+
+private:
+	std::vector<uint32_t> sorted; // by folded title, then handle; may hold handles flagged as removed
+	std::vector<uint32_t> added; // handles added since the last merge, in no order
+	std::vector<uint8_t> states; // by handle, a combination of the flags in TitleIndex.cpp
+	std::vector<uint32_t> trigramCounts; // by handle, the postings its title added
+	std::unordered_map<uint32_t, std::vector<uint32_t> > trigrams;
+	size_t removedSorted; // handles in the sorted list that have been removed or replaced since the last merge
+	size_t livePostings;
+	size_t stalePostings;
+
+	void post(uint32_t handle, const std::string& folded);
+	void compact(const BidStore& bids);
+	void merge(const BidStore& bids);
+	void candidates(const std::vector<uint32_t>& found, const std::string& folded, const BidStore& bids, std::vector<uint32_t>* handles) const;
+	static void trigramsOf(const std::string& folded, std::vector<uint32_t>* found);
+
+public:
+	TitleIndex();
+	void Add(uint32_t handle, const BidStore& bids);
+	void Remove(uint32_t handle);
+	void Clear();
+	void Prefix(const std::string& prefix, const BidStore& bids, std::vector<uint32_t>* handles);
+	void Substring(const std::string& text, const BidStore& bids, std::vector<uint32_t>* handles) const;
+	size_t MemoryUsage() const;
+
+	static std::string Fold(const std::string& text);
+};
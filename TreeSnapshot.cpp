@@ -0,0 +1,95 @@
+#include "TreeSnapshot.hpp"
+#include "BinarySearchTree.hpp"
+
+/**
+ * Constructor. Snapshots are taken with BinarySearchTree::Snapshot.
+ * @param tree: The tree the snapshot belongs to.
+ * @param root: The root of the tree when the snapshot was taken.
+ * @param epoch: The epoch the snapshot was taken in.
+ */
+TreeSnapshot::TreeSnapshot(BinarySearchTree* tree, uint32_t root, uint32_t epoch) {
+	this->tree = tree;
+	this->root = root;
+	this->epoch = epoch;
+	started = false;
+}
+
+/**
+ * Destructor
+ */
+TreeSnapshot::~TreeSnapshot() {
+	tree->releaseSnapshot(epoch);
+}
+
+/**
+ * Read the next bids in order of ID. The tree's storage is only locked while
+ * a batch is copied, so a long export never holds up the writer for long.
+ * @param batch: Receives up to BATCH_SIZE bids.
+ * @return False once every bid has been read.
+ */
+bool TreeSnapshot::NextBatch(std::vector<Bid>* batch) {
+	batch->clear();
+
+	std::shared_lock<std::shared_timed_mutex> reading(tree->storageLock);
+	const std::vector<Node>& nodes = tree->nodes;
+
+	// Start by walking down the left spine from the root.
+	if (!started) {
+		started = true;
+
+		for (uint32_t cur = root; cur != NIL_INDEX; cur = nodes[cur].left) {
+			stack.push_back(cur);
+		}
+	}
+
+	while (!stack.empty() && batch->size() < BATCH_SIZE) {
+		uint32_t node = stack.back();
+		stack.pop_back();
+
+		batch->push_back(tree->bids.Get(nodes[node].bid));
+
+		// The next node is the leftmost one in the right subtree.
+		for (uint32_t cur = nodes[node].right; cur != NIL_INDEX; cur = nodes[cur].left) {
+			stack.push_back(cur);
+		}
+	}
+
+	return !batch->empty();
+}
+
+/**
+ * Start NextBatch over from the first bid.
+ */
+void TreeSnapshot::Rewind() {
+	stack.clear();
+	started = false;
+}
+
+/**
+ * Search the snapshot for a bid.
+ * @param bidId: Id to search for.
+ * @return If the bid exists, it is returned. Otherwise, an empty bid is returned.
+ */
+Bid TreeSnapshot::Search(std::string bidId) {
+	uint32_t key;
+
+	if (!BidStore::ParseKey(bidId, &key)) {
+		return Bid();
+	}
+
+	std::shared_lock<std::shared_timed_mutex> reading(tree->storageLock);
+	const std::vector<Node>& nodes = tree->nodes;
+	uint32_t cur = root;
+
+	while (cur != NIL_INDEX) {
+		uint32_t curKey = tree->bids.Key(nodes[cur].bid);
+
+		if (curKey == key) {
+			return tree->bids.Get(nodes[cur].bid);
+		}
+
+		cur = (curKey > key) ? nodes[cur].left : nodes[cur].right;
+	}
+
+	return Bid();
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Bid.hpp"
+
+class BinarySearchTree;
+
+/**
+ * Define a read-only view of a tree as it was when the view was taken. It can
+ * be read from any thread while the tree keeps changing. Destroying it lets
+ * the tree reclaim the nodes only this view could see.
+ */
+class TreeSnapshot {
+
+private:
+	BinarySearchTree* tree;
+	uint32_t root;
+	uint32_t epoch;
+	std::vector<uint32_t> stack; // in-order cursor for NextBatch
+	bool started;
+
+	TreeSnapshot(const TreeSnapshot&);
+	TreeSnapshot& operator=(const TreeSnapshot&);
+
+public:
+	static const size_t BATCH_SIZE = 1024;
+
+	TreeSnapshot(BinarySearchTree* tree, uint32_t root, uint32_t epoch);
+	virtual ~TreeSnapshot();
+	bool NextBatch(std::vector<Bid>* batch);
+	void Rewind();
+	Bid Search(std::string bidId);
+};
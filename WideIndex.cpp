@@ -0,0 +1,263 @@
+#include "WideIndex.hpp"
+#include "Node.hpp"
+
+// Define BST_NO_SIMD to build the scalar block search on x86 too, or BST_NO_AVX2 to never pick AVX2; IndexTest is built each way.
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)) && !defined(BST_NO_SIMD)
+#define WIDE_INDEX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need AVX2 enabled per function; MSVC accepts the intrinsics anywhere.
+#if defined(WIDE_INDEX_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+
+	// Keys are stored with the sign bit flipped so the signed SIMD compares order them as unsigned.
+	const uint32_t KEY_BIAS = 0x80000000u;
+	const uint32_t PADDING = 0xFFFFFFFFu ^ KEY_BIAS;
+
+	typedef unsigned (*RankFunction)(const uint32_t* block, uint32_t key);
+
+#ifdef BST_NO_AVX2
+	const bool AVX2_ALLOWED = false;
+#else
+	const bool AVX2_ALLOWED = true;
+#endif
+
+#ifdef WIDE_INDEX_X86
+	/**
+	 * Count the set bits in a 16-bit compare mask.
+	 */
+	unsigned bitCount(unsigned mask) {
+		mask = mask - ((mask >> 1) & 0x5555);
+		mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+		mask = (mask + (mask >> 4)) & 0x0F0F;
+		return (mask + (mask >> 8)) & 0x1F;
+	}
+
+	/**
+	 * Count the keys in a block that are less than the given key, four at a time.
+	 */
+	unsigned rankSse2(const uint32_t* block, uint32_t key) {
+		__m128i target = _mm_set1_epi32((int)key);
+		const __m128i* keys = (const __m128i*)block;
+
+		__m128i lt0 = _mm_cmpgt_epi32(target, _mm_loadu_si128(keys + 0));
+		__m128i lt1 = _mm_cmpgt_epi32(target, _mm_loadu_si128(keys + 1));
+		__m128i lt2 = _mm_cmpgt_epi32(target, _mm_loadu_si128(keys + 2));
+		__m128i lt3 = _mm_cmpgt_epi32(target, _mm_loadu_si128(keys + 3));
+
+		// Narrow the sixteen 32-bit lanes to bytes so one movemask covers the block.
+		__m128i packed = _mm_packs_epi16(_mm_packs_epi32(lt0, lt1), _mm_packs_epi32(lt2, lt3));
+
+		return bitCount((unsigned)_mm_movemask_epi8(packed));
+	}
+
+	/**
+	 * Count the keys in a block that are less than the given key, eight at a time.
+	 */
+	TARGET_AVX2 unsigned rankAvx2(const uint32_t* block, uint32_t key) {
+		__m256i target = _mm256_set1_epi32((int)key);
+		const __m256i* keys = (const __m256i*)block;
+
+		__m256i lt0 = _mm256_cmpgt_epi32(target, _mm256_loadu_si256(keys + 0));
+		__m256i lt1 = _mm256_cmpgt_epi32(target, _mm256_loadu_si256(keys + 1));
+
+		unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lt0))
+			| ((unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(lt1)) << 8);
+
+		return bitCount(mask);
+	}
+
+	/**
+	 * Check whether the processor and operating system support AVX2.
+	 */
+	bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+		int info[4];
+
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+
+		// AVX needs OSXSAVE and the OS must save the YMM registers.
+		__cpuid(info, 1);
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+			return false;
+		}
+		if ((_xgetbv(0) & 6) != 6) {
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#else
+	/**
+	 * Count the keys in a block that are less than the given key, one at a time.
+	 */
+	unsigned rankScalar(const uint32_t* block, uint32_t key) {
+		unsigned rank = 0;
+
+		for (size_t i = 0; i < WideIndex::BLOCK_KEYS; i++) {
+			rank += ((int32_t)block[i] < (int32_t)key) ? 1 : 0;
+		}
+
+		return rank;
+	}
+#endif
+
+	/**
+	 * Pick the fastest block search this processor supports.
+	 */
+	RankFunction selectRank() {
+#ifdef WIDE_INDEX_X86
+		if (AVX2_ALLOWED && cpuHasAvx2()) {
+			return rankAvx2;
+		}
+		return rankSse2;
+#else
+		return rankScalar;
+#endif
+	}
+
+	/**
+	 * Get the block search chosen for this processor, detecting it on first use.
+	 */
+	RankFunction rank() {
+		static const RankFunction selected = selectRank();
+		return selected;
+	}
+}
+
+/**
+ * Default constructor
+ */
+WideIndex::WideIndex() {
+	count = 0;
+}
+
+/**
+ * Build the index from keys in ascending order.
+ * @param keys: The sorted keys.
+ * @param values: The value stored with each key.
+ */
+void WideIndex::Build(const std::vector<uint32_t>& keys, const std::vector<uint32_t>& values) {
+	Clear();
+
+	if (keys.empty()) {
+		return;
+	}
+
+	count = keys.size();
+	this->values = values;
+
+	// Pack the keys into whole blocks, padding the last block with the largest key.
+	std::vector<uint32_t> leaves;
+	leaves.reserve((count + BLOCK_KEYS - 1) / BLOCK_KEYS * BLOCK_KEYS);
+
+	for (size_t i = 0; i < count; i++) {
+		leaves.push_back(keys[i] ^ KEY_BIAS);
+	}
+	while (leaves.size() % BLOCK_KEYS != 0) {
+		leaves.push_back(PADDING);
+	}
+
+	levels.push_back(leaves);
+
+	// Each upper level holds the largest key of every block in the level below.
+	while (levels.back().size() > BLOCK_KEYS) {
+		const std::vector<uint32_t>& below = levels.back();
+		std::vector<uint32_t> upper;
+
+		for (size_t block = 0; block < below.size() / BLOCK_KEYS; block++) {
+			upper.push_back(below[block * BLOCK_KEYS + BLOCK_KEYS - 1]);
+		}
+		while (upper.size() % BLOCK_KEYS != 0) {
+			upper.push_back(PADDING);
+		}
+
+		levels.push_back(upper);
+	}
+}
+
+/**
+ * Remove every key from the index.
+ */
+void WideIndex::Clear() {
+	levels.clear();
+	values.clear();
+	count = 0;
+}
+
+/**
+ * Find a key in the index.
+ * @param key: The key to find.
+ * @return The value stored with the key, or NIL_INDEX if it is not present.
+ */
+uint32_t WideIndex::Find(uint32_t key) const {
+	if (count == 0) {
+		return NIL_INDEX;
+	}
+
+	RankFunction rankBlock = rank();
+	uint32_t target = key ^ KEY_BIAS;
+	size_t block = 0;
+
+	// Descend from the root, choosing the first child whose largest key is not below the target.
+	for (size_t level = levels.size() - 1; level > 0; level--) {
+		size_t child = block * BLOCK_KEYS + rankBlock(&levels[level][block * BLOCK_KEYS], target);
+
+		if (child * BLOCK_KEYS >= levels[level - 1].size()) {
+			return NIL_INDEX;
+		}
+
+		block = child;
+	}
+
+	size_t pos = block * BLOCK_KEYS + rankBlock(&levels[0][block * BLOCK_KEYS], target);
+
+	if (pos < count && levels[0][pos] == target) {
+		return values[pos];
+	}
+
+	return NIL_INDEX;
+}
+
+/**
+ * Estimate the heap memory held by the index.
+ * @return The number of bytes reserved by the levels and values.
+ */
+size_t WideIndex::MemoryUsage() const {
+	size_t bytes = values.capacity() * sizeof(uint32_t);
+
+	for (size_t i = 0; i < levels.size(); i++) {
+		bytes += levels[i].capacity() * sizeof(uint32_t);
+	}
+
+	return bytes;
+}
+
+/**
+ * Name the block search chosen for this processor.
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char* WideIndex::Implementation() {
+#ifdef WIDE_INDEX_X86
+	return (rank() == rankAvx2) ? "avx2" : "sse2";
+#else
+	return "scalar";
+#endif
+}
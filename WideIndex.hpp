@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Define a read-only index over sorted integer keys. Keys are packed into
+ * blocks of sixteen, one cache line each, and every upper level holds the
+ * largest key of each block below it. A block is searched by comparing all
+ * sixteen keys at once with SSE2 or AVX2, chosen at run time, with a scalar
+ * fallback for other processors.
+ */
+class WideIndex {
+
+public:
+	static const size_t BLOCK_KEYS = 16;
+
+private:
+	std::vector<std::vector<uint32_t> > levels; // levels[0] holds every key, the last level is the root block
+	std::vector<uint32_t> values;
+	size_t count;
+
+public:
+	WideIndex();
+	void Build(const std::vector<uint32_t>& keys, const std::vector<uint32_t>& values);
+	void Clear();
+	bool Empty() const { return count == 0; }
+	uint32_t Find(uint32_t key) const;
+	size_t MemoryUsage() const;
+
+	static const char* Implementation();
+};